@@ -0,0 +1,43 @@
+#ifndef ATOMIC_MCP2515_H
+#define ATOMIC_MCP2515_H
+
+#include <stdint.h>
+
+// Позиции кольцевых буферов без блокировок разделяются писателем и
+// читателем: публикация данных (head) и освобождение места (tail) должны
+// быть упорядочены относительно копирования данных. Позиции - обычные поля
+// uint32_t (структуры используются и из C++), поэтому вместо атомарных
+// типов C11, требующих объявления полей _Atomic, используются встроенные
+// функции GCC/Clang, работающие с обычными объектами. Для другого
+// компилятора на одноядерном микроконтроллере достаточно запретить
+// компилятору перестановку обращений к памяти: для этого при сборке задается
+// MCP_COMPILER_BARRIER() (например, -DMCP_COMPILER_BARRIER()=__schedule_barrier()).
+
+#if defined(__GNUC__)
+static inline uint32_t mcpLoadAcquire(const uint32_t* p)
+{
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void mcpStoreRelease(uint32_t* p, uint32_t value)
+{
+  __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+#elif defined(MCP_COMPILER_BARRIER)
+static inline uint32_t mcpLoadAcquire(const uint32_t* p)
+{
+  uint32_t value = *(const volatile uint32_t*) p;
+  MCP_COMPILER_BARRIER();
+  return value;
+}
+
+static inline void mcpStoreRelease(uint32_t* p, uint32_t value)
+{
+  MCP_COMPILER_BARRIER();
+  *(volatile uint32_t*) p = value;
+}
+#else
+#  error "No atomics: use GCC/Clang or define MCP_COMPILER_BARRIER() for a single-core target"
+#endif
+
+#endif  // ATOMIC_MCP2515_H
@@ -0,0 +1,111 @@
+#include "coalesce_mcp2515.h"
+#include "command_mcp2515.h"
+
+#define OFFSET_CMD_WRITE 2U
+
+/// @brief Вычисляет полное значение регистра, если оно известно
+/// @return true, если значение известно целиком
+static bool fullValue(const MCP_Coalesce* co, uint8_t i, uint8_t* value)
+{
+  uint8_t known;
+
+  if (co->mask[i] == 0xFFU)
+  {
+    *value = co->data[i];
+    return true;
+  }
+  if (co->ins->shadow && mcpShadowGet(co->ins->shadow, co->addr[i], &known))
+  {
+    *value = (uint8_t) ((known & ~co->mask[i]) | co->data[i]);
+    return true;
+  }
+  return false;
+}
+
+void mcpCoalesceInit(MCP_Coalesce* co, MCP_Instance* ins)
+{
+  co->ins      = ins;
+  co->count    = 0;
+  co->merged   = 0;
+  co->writes   = 0;
+  co->modifies = 0;
+}
+
+int32_t mcpCoalesceModify(MCP_Coalesce* co, uint8_t addr, uint8_t mask, uint8_t data)
+{
+  uint8_t i = 0;
+  while ((i < co->count) && (co->addr[i] < addr))
+  {
+    i++;
+  }
+
+  if ((i < co->count) && (co->addr[i] == addr))
+  {
+    co->data[i] = (uint8_t) ((co->data[i] & ~mask) | (data & mask));
+    co->mask[i] |= mask;
+    co->merged++;
+    return MCP_OK;
+  }
+
+  // без поддержки BIT MODIFY микросхема записывает байт целиком, поэтому
+  // частичная маска допустима, только если остальные биты известны
+  uint8_t known;
+  if ((mask != 0xFFU) && !mcpBitModifiable(addr))
+  {
+    if (!co->ins->shadow || !mcpShadowGet(co->ins->shadow, addr, &known))
+    {
+      return MCP_ERROR;
+    }
+    data = (uint8_t) ((known & ~mask) | (data & mask));
+    mask = 0xFFU;
+  }
+
+  if (co->count >= MCP_COALESCE_SLOTS)
+  {
+    return MCP_ERROR_BUFFER;
+  }
+  for (uint8_t j = co->count; j > i; j--)
+  {
+    co->addr[j] = co->addr[j - 1U];
+    co->mask[j] = co->mask[j - 1U];
+    co->data[j] = co->data[j - 1U];
+  }
+  co->addr[i] = addr;
+  co->mask[i] = mask;
+  co->data[i] = (uint8_t) (data & mask);
+  co->count++;
+  return MCP_OK;
+}
+
+int32_t mcpCoalesceCommit(MCP_Coalesce* co)
+{
+  uint8_t run[MCP_COALESCE_SLOTS];
+  int32_t res = MCP_OK;
+  uint8_t i   = 0;
+
+  while ((i < co->count) && (res == MCP_OK))
+  {
+    uint8_t n = 0;
+    while ((i + n < co->count) && (n < MCP_BUFFER_SIZE - OFFSET_CMD_WRITE)
+           && ((n == 0U) || (co->addr[i + n] == (uint8_t) (co->addr[i] + n))) && fullValue(co, (uint8_t) (i + n), &run[n]))
+    {
+      n++;
+    }
+
+    if (n)
+    {
+      res = mcpWrite(co->ins, co->addr[i], run, n);
+      co->writes++;
+      i = (uint8_t) (i + n);
+    }
+    else
+    {
+      res = mcpBitModify(co->ins, co->addr[i], co->mask[i], co->data[i]);
+      co->modifies++;
+      i++;
+    }
+  }
+
+  co->count = 0;
+  return res;
+}
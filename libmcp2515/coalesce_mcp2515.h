@@ -0,0 +1,76 @@
+#ifndef COALESCE_MCP2515_H
+#define COALESCE_MCP2515_H
+
+#include "driver_mcp2515.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Количество регистров, изменения которых накапливаются до фиксации.
+/// Допустимые значения: 1..128.
+#ifndef MCP_COALESCE_SLOTS
+#  define MCP_COALESCE_SLOTS 8U
+#endif
+#if (MCP_COALESCE_SLOTS < 1) || (MCP_COALESCE_SLOTS > 128)
+#  error "MCP_COALESCE_SLOTS must be in range 1..128"
+#endif
+
+/// @brief Структура для описания отложенных побитовых изменений регистров
+/// @details Изменения (mcpCoalesceModify) накапливаются по адресам регистров:
+/// маски объединяются, при пересечении масок действует более позднее
+/// значение. Обмен по SPI выполняется только при явной фиксации
+/// (mcpCoalesceCommit): для каждого регистра - не более одной команды, причем
+/// регистры, значение которых известно целиком (маска 0xFF или значение
+/// есть в теневой копии экземпляра), записываются командой WRITE, а соседние
+/// такие регистры - одной пакетной записью.
+/// @b
+/// Внутри одной фиксации регистры записываются по возрастанию адреса, поэтому
+/// изменения, порядок которых важен (например, смена режима перед записью
+/// CNF1..CNF3), следует разделять фиксацией.
+struct MCP_Coalesce
+{
+  MCP_Instance* ins; ///< Экземпляр драйвера
+
+  uint8_t addr[MCP_COALESCE_SLOTS]; ///< Адреса регистров (по возрастанию)
+  uint8_t mask[MCP_COALESCE_SLOTS]; ///< Объединенные маски
+  uint8_t data[MCP_COALESCE_SLOTS]; ///< Значения битов маски
+  uint8_t count;                    ///< Количество регистров с изменениями
+
+  uint32_t merged;   ///< Количество изменений, объединенных с уже накопленными
+  uint32_t writes;   ///< Количество выполненных команд WRITE
+  uint32_t modifies; ///< Количество выполненных команд BIT MODIFY
+};
+typedef struct MCP_Coalesce MCP_Coalesce;
+
+/// @brief Инициализирует отложенные изменения
+/// @param [in] co указатель на отложенные изменения
+/// @param [in] ins указатель на экземпляр драйвера
+void mcpCoalesceInit(MCP_Coalesce* co, MCP_Instance* ins);
+
+/// @brief Откладывает побитовое изменение регистра (аналог mcpBitModify)
+/// @param [in] co указатель на отложенные изменения
+/// @param [in] addr адрес регистра
+/// @param [in] mask маска изменяемых битов
+/// @param [in] data записываемое значение
+/// @return MCP_OK, если изменение учтено;
+///         MCP_ERROR, если регистр не поддерживает BIT MODIFY, а его значение
+///         не известно целиком;
+///         MCP_ERROR_BUFFER, если заняты все MCP_COALESCE_SLOTS регистров
+/// @details Регистры, не поддерживающие BIT MODIFY (фильтры, маски, буферы
+/// передачи), микросхема записывает целиком. Изменение такого регистра
+/// принимается, если маска равна 0xFF, регистр уже накоплен с известным
+/// значением или его значение есть в теневой копии экземпляра.
+int32_t mcpCoalesceModify(MCP_Coalesce* co, uint8_t addr, uint8_t mask, uint8_t data);
+
+/// @brief Выполняет накопленные изменения
+/// @param [in] co указатель на отложенные изменения
+/// @return MCP_OK, если транзакции данных завершены успешно;
+///         иначе возвращает код ошибки первой неудачной транзакции
+/// @details Накопленные изменения сбрасываются в любом случае.
+int32_t mcpCoalesceCommit(MCP_Coalesce* co);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // COALESCE_MCP2515_H
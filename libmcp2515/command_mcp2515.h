@@ -0,0 +1,100 @@
+#ifndef COMMAND_MCP2515_H
+#define COMMAND_MCP2515_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Классификация команд SPI по первому байту транзакции. Общая для статистики
+// драйвера (MCP_STATISTICS) и модели стоимости обмена (spicost_mcp2515.h),
+// чтобы их счетчики индексировались одинаково. Здесь же - перечень регистров,
+// поддерживающих BIT MODIFY (общий для модели и отложенных изменений).
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Типы команд SPI (по байту команды)
+typedef enum
+{
+  MCP_COMMAND_RESET = 0,  ///< RESET
+  MCP_COMMAND_READ,       ///< READ
+  MCP_COMMAND_WRITE,      ///< WRITE
+  MCP_COMMAND_BITMODIFY,  ///< BIT MODIFY
+  MCP_COMMAND_LOADTX,     ///< LOAD TX BUFFER
+  MCP_COMMAND_READRX,     ///< READ RX BUFFER
+  MCP_COMMAND_RTS,        ///< RTS
+  MCP_COMMAND_READSTATUS, ///< READ STATUS
+  MCP_COMMAND_RXSTATUS,   ///< RX STATUS
+  MCP_COMMAND_OTHER,      ///< Неизвестная команда
+  MCP_COMMAND_TYPES       ///< Количество типов команд
+} MCPCommandType;
+
+/// @brief Определяет тип команды по ее первому байту
+/// @param [in] cmd байт команды
+/// @return тип команды (см. MCPCommandType)
+static inline uint8_t mcpCommandType(uint8_t cmd)
+{
+  switch (cmd)
+  {
+  case 0xC0U:
+    return MCP_COMMAND_RESET;
+  case 0x03U:
+    return MCP_COMMAND_READ;
+  case 0x02U:
+    return MCP_COMMAND_WRITE;
+  case 0x05U:
+    return MCP_COMMAND_BITMODIFY;
+  case 0xA0U:
+    return MCP_COMMAND_READSTATUS;
+  case 0xB0U:
+    return MCP_COMMAND_RXSTATUS;
+  default:
+    break;
+  }
+
+  if ((cmd & 0xF8U) == 0x40U)
+  {
+    return MCP_COMMAND_LOADTX;
+  }
+  if ((cmd & 0xF9U) == 0x90U)
+  {
+    return MCP_COMMAND_READRX;
+  }
+  if ((cmd & 0xF8U) == 0x80U)
+  {
+    return MCP_COMMAND_RTS;
+  }
+  return MCP_COMMAND_OTHER;
+}
+
+/// @brief Проверяет, поддерживает ли регистр команду BIT MODIFY
+/// @param [in] addr адрес регистра
+/// @return true, если маска команды применяется; иначе микросхема записывает
+/// значение целиком
+static inline bool mcpBitModifiable(uint8_t addr)
+{
+  switch (addr)
+  {
+  case 0x0CU:  // BFPCTRL
+  case 0x0DU:  // TXRTSCTRL
+  case 0x28U:  // CNF3
+  case 0x29U:  // CNF2
+  case 0x2AU:  // CNF1
+  case 0x2BU:  // CANINTE
+  case 0x2CU:  // CANINTF
+  case 0x2DU:  // EFLG
+  case 0x30U:  // TXB0CTRL
+  case 0x40U:  // TXB1CTRL
+  case 0x50U:  // TXB2CTRL
+  case 0x60U:  // RXB0CTRL
+  case 0x70U:  // RXB1CTRL
+    return true;
+  default:
+    return (addr & 0x8FU) == 0x0FU;  // CANCTRL и его зеркала
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // COMMAND_MCP2515_H
@@ -0,0 +1,357 @@
+#include "config_mcp2515.h"
+
+#define OFFSET_CMD 2U
+
+#define REG_BFPCTRL   0x0CU
+#define REG_TXRTSCTRL 0x0DU
+#define REG_CANSTAT   0x0EU
+#define REG_CNF3      0x28U
+#define REG_CNF1      0x2AU
+#define REG_RXB0CTRL  0x60U
+#define REG_RXB1CTRL  0x70U
+
+#define FNV_OFFSET 2166136261UL
+#define FNV_PRIME  16777619UL
+
+/// @brief Возвращает адрес регистра конфигурации по его номеру
+static uint8_t configAddress(uint8_t i)
+{
+  if (i < 14U)
+  {
+    return i;  // RXF0..RXF2, BFPCTRL, TXRTSCTRL
+  }
+  if (i < 26U)
+  {
+    return (uint8_t) (i + 2U);  // RXF3..RXF5
+  }
+  if (i < 38U)
+  {
+    return (uint8_t) (i + 6U);  // RXM0, RXM1, CNF3..CNF1, CANINTE
+  }
+  return (i == 38U) ? REG_RXB0CTRL : REG_RXB1CTRL;
+}
+
+/// @brief Возвращает маску битов регистра конфигурации, доступных для записи
+static uint8_t configMask(uint8_t addr)
+{
+  switch (addr)
+  {
+  case REG_BFPCTRL:
+    return 0x3FU;
+  case REG_TXRTSCTRL:
+    return 0x07U;
+  case REG_CNF3:
+    return 0xC7U;
+  case REG_RXB0CTRL:
+    return 0x64U;
+  case REG_RXB1CTRL:
+    return 0x60U;
+  default:
+    break;
+  }
+  if ((addr < REG_CNF3) && ((addr & 0x03U) == 0x01U))
+  {
+    return (addr < 0x20U) ? 0xEBU : 0xE3U;  // RXFnSIDL, RXMnSIDL
+  }
+  return 0xFFU;
+}
+
+/// @brief Проверяет, доступен ли регистр для записи только в режиме конфигурации
+static bool isConfigOnly(uint8_t addr)
+{
+  if ((addr >= REG_CNF3) && (addr <= REG_CNF1))
+  {
+    return true;
+  }
+  return (addr < REG_CNF3) && ((addr & 0x0FU) != REG_BFPCTRL);
+}
+
+/// @brief Заполняет образ регистров конфигурации (по возрастанию адреса)
+static void configImage(const MCP_Config* cfg, uint8_t* image)
+{
+  for (uint8_t i = 0; i < 3U; i++)
+  {
+    for (uint8_t j = 0; j < 4U; j++)
+    {
+      image[i * 4U + j]       = cfg->rxf[i][j];
+      image[14U + i * 4U + j] = cfg->rxf[i + 3U][j];
+    }
+  }
+  for (uint8_t i = 0; i < 2U; i++)
+  {
+    for (uint8_t j = 0; j < 4U; j++)
+    {
+      image[26U + i * 4U + j] = cfg->rxm[i][j];
+    }
+  }
+  image[12] = cfg->bfpctrl;
+  image[13] = cfg->txrtsctrl;
+  image[34] = cfg->cnf3;
+  image[35] = cfg->cnf2;
+  image[36] = cfg->cnf1;
+  image[37] = cfg->caninte;
+  image[38] = cfg->rxb0ctrl;
+  image[39] = cfg->rxb1ctrl;
+}
+
+static bool isSet(const uint8_t* map, uint8_t i)
+{
+  return (map[i >> 3] & (1U << (i & 7U))) != 0U;
+}
+
+static void set(uint8_t* map, uint8_t i)
+{
+  map[i >> 3] |= (uint8_t) (1U << (i & 7U));
+}
+
+int32_t mcpConfigDiff(MCP_Instance* ins, const MCP_Config* target, const MCP_Config* current, MCP_ConfigDiff* diff)
+{
+  uint8_t image[MCP_CONFIG_REGISTERS];
+  uint8_t state[MCP_CONFIG_REGISTERS];
+  uint8_t known[(MCP_CONFIG_REGISTERS + 7U) / 8U] = {0};
+
+  if (current)
+  {
+    configImage(current, state);
+    for (uint8_t i = 0; i < MCP_CONFIG_REGISTERS; i++)
+    {
+      set(known, i);
+    }
+  }
+  else if (ins->shadow)
+  {
+    for (uint8_t i = 0; i < MCP_CONFIG_REGISTERS; i++)
+    {
+      if (mcpShadowGet(ins->shadow, configAddress(i), &state[i]))
+      {
+        set(known, i);
+      }
+    }
+  }
+
+  // неизвестные регистры читаются пакетами, захватывающими промежуточные адреса
+  uint8_t i = 0;
+  while (i < MCP_CONFIG_REGISTERS)
+  {
+    if (isSet(known, i))
+    {
+      i++;
+      continue;
+    }
+
+    uint8_t start = configAddress(i);
+    uint8_t last  = i;
+    for (uint8_t j = (uint8_t) (i + 1U); j < MCP_CONFIG_REGISTERS; j++)
+    {
+      if ((uint8_t) (configAddress(j) - start) >= MCP_BUFFER_SIZE - OFFSET_CMD)
+      {
+        break;
+      }
+      if (!isSet(known, j))
+      {
+        last = j;
+      }
+    }
+
+    uint8_t data[MCP_BUFFER_SIZE];
+    int32_t res = mcpReadInto(ins, start, data, (uint8_t) (configAddress(last) - start + 1U));
+    if (res != MCP_OK)
+    {
+      return res;
+    }
+    for (uint8_t j = i; j <= last; j++)
+    {
+      state[j] = data[configAddress(j) - start];
+    }
+    i = (uint8_t) (last + 1U);
+  }
+
+  configImage(target, image);
+  for (uint8_t j = 0; j < sizeof(diff->changed); j++)
+  {
+    diff->changed[j] = 0;
+  }
+  diff->count      = 0;
+  diff->configMode = false;
+  for (uint8_t j = 0; j < MCP_CONFIG_REGISTERS; j++)
+  {
+    uint8_t addr = configAddress(j);
+    if ((image[j] ^ state[j]) & configMask(addr))
+    {
+      set(diff->changed, j);
+      diff->count++;
+      diff->configMode = diff->configMode || isConfigOnly(addr);
+    }
+  }
+  return MCP_OK;
+}
+
+int32_t mcpConfigApply(MCP_Instance* ins, const MCP_Config* target, const MCP_ConfigDiff* diff)
+{
+  uint8_t image[MCP_CONFIG_REGISTERS];
+  configImage(target, image);
+
+  uint8_t i = 0;
+  while (i < MCP_CONFIG_REGISTERS)
+  {
+    if (!isSet(diff->changed, i))
+    {
+      i++;
+      continue;
+    }
+
+    // пакет продолжается, пока адреса идут подряд (CANSTAT и CANCTRL не
+    // захватываются) и данные помещаются в буфер
+    uint8_t start = configAddress(i);
+    uint8_t last  = i;
+    for (uint8_t j = (uint8_t) (i + 1U); j < MCP_CONFIG_REGISTERS; j++)
+    {
+      uint8_t addr = configAddress(j);
+      if ((addr != configAddress((uint8_t) (j - 1U)) + 1U) || ((uint8_t) (addr - start) >= MCP_BUFFER_SIZE - OFFSET_CMD))
+      {
+        break;
+      }
+      if (isSet(diff->changed, j))
+      {
+        last = j;
+      }
+    }
+
+    int32_t res = mcpWrite(ins, start, &image[i], (uint8_t) (last - i + 1U));
+    if (res != MCP_OK)
+    {
+      return res;
+    }
+    i = (uint8_t) (last + 1U);
+  }
+  return MCP_OK;
+}
+
+/// @brief Заполняет конфигурацию по образу регистров (обратно configImage)
+static void configFromImage(const uint8_t* image, MCP_Config* cfg)
+{
+  for (uint8_t i = 0; i < 3U; i++)
+  {
+    for (uint8_t j = 0; j < 4U; j++)
+    {
+      cfg->rxf[i][j]      = image[i * 4U + j];
+      cfg->rxf[i + 3U][j] = image[14U + i * 4U + j];
+    }
+  }
+  for (uint8_t i = 0; i < 2U; i++)
+  {
+    for (uint8_t j = 0; j < 4U; j++)
+    {
+      cfg->rxm[i][j] = image[26U + i * 4U + j];
+    }
+  }
+  cfg->bfpctrl   = image[12];
+  cfg->txrtsctrl = image[13];
+  cfg->cnf3      = image[34];
+  cfg->cnf2      = image[35];
+  cfg->cnf1      = image[36];
+  cfg->caninte   = image[37];
+  cfg->rxb0ctrl  = image[38];
+  cfg->rxb1ctrl  = image[39];
+}
+
+/// @brief Вычисляет отпечаток образа регистров конфигурации
+static uint32_t imageFingerprint(const uint8_t* image)
+{
+  uint32_t hash = FNV_OFFSET;
+
+  for (uint8_t i = 0; i < MCP_CONFIG_REGISTERS; i++)
+  {
+    uint8_t addr = configAddress(i);
+    hash         = (hash ^ (uint8_t) (image[i] & configMask(addr))) * FNV_PRIME;
+  }
+  return hash;
+}
+
+uint32_t mcpConfigFingerprint(const MCP_Config* cfg)
+{
+  uint8_t image[MCP_CONFIG_REGISTERS];
+
+  configImage(cfg, image);
+  return imageFingerprint(image);
+}
+
+/// @brief Читает образ регистров конфигурации
+/// @param [out] image образ регистров (MCP_CONFIG_REGISTERS байт)
+/// @param [out] mode текущий режим работы (поле OPMOD регистра CANSTAT)
+static int32_t readImage(MCP_Instance* ins, uint8_t* image, uint8_t* mode)
+{
+  uint8_t i = 0;
+
+  while (i < MCP_CONFIG_REGISTERS)
+  {
+    uint8_t start = configAddress(i);
+    uint8_t last  = i;
+    while ((last + 1U < MCP_CONFIG_REGISTERS)
+           && ((uint8_t) (configAddress((uint8_t) (last + 1U)) - start) < MCP_BUFFER_SIZE - OFFSET_CMD))
+    {
+      last++;
+    }
+
+    uint8_t* data;
+    int32_t  res = mcpRead(ins, start, &data, (uint8_t) (configAddress(last) - start + 1U));
+    if (res != MCP_OK)
+    {
+      return res;
+    }
+    // первый пакет (от RXF0SIDH) всегда захватывает CANSTAT
+    if (start == 0U)
+    {
+      *mode = (uint8_t) (data[REG_CANSTAT] >> 5);
+    }
+    for (uint8_t j = i; j <= last; j++)
+    {
+      image[j] = data[configAddress(j) - start];
+    }
+    i = (uint8_t) (last + 1U);
+  }
+  return MCP_OK;
+}
+
+int32_t mcpConfigWarmStart(MCP_Instance* ins, const MCP_Config* cfg, uint8_t mode, uint8_t polls, bool* reprogrammed)
+{
+  uint8_t image[MCP_CONFIG_REGISTERS];
+  uint8_t current = MCP_MODE_CONFIG;
+
+  *reprogrammed = false;
+  if (polls == 0U)
+  {
+    return MCP_ERROR;
+  }
+  int32_t res = readImage(ins, image, &current);
+  if (res != MCP_OK)
+  {
+    return res;
+  }
+
+  if (imageFingerprint(image) != mcpConfigFingerprint(cfg))
+  {
+    MCP_Config     state;
+    MCP_ConfigDiff diff;
+
+    // прочитанный образ служит известным состоянием: повторного чтения нет
+    configFromImage(image, &state);
+    *reprogrammed = true;
+    res           = mcpConfigDiff(ins, cfg, &state, &diff);
+    if ((res == MCP_OK) && diff.configMode && (current != MCP_MODE_CONFIG))
+    {
+      res     = mcpSetMode(ins, MCP_MODE_CONFIG, polls);
+      current = MCP_MODE_CONFIG;
+    }
+    if (res == MCP_OK)
+    {
+      res = mcpConfigApply(ins, cfg, &diff);
+    }
+    if (res != MCP_OK)
+    {
+      return res;
+    }
+  }
+
+  return (current != mode) ? mcpSetMode(ins, mode, polls) : MCP_OK;
+}
@@ -0,0 +1,111 @@
+#ifndef CONFIG_MCP2515_H
+#define CONFIG_MCP2515_H
+
+#include "driver_mcp2515.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Количество регистров конфигурации: фильтры и маски, BFPCTRL, TXRTSCTRL,
+/// CNF1..CNF3, CANINTE, RXB0CTRL и RXB1CTRL
+#define MCP_CONFIG_REGISTERS 40U
+
+/// @brief Структура для описания конфигурации MCP2515
+/// @details Значения сравниваются с состоянием микросхемы только по битам,
+/// доступным для записи (например, для RXB0CTRL - RXM и BUKT).
+struct MCP_Config
+{
+  uint8_t rxf[6][4]; ///< Фильтры RXF0..RXF5 (SIDH, SIDL, EID8, EID0)
+  uint8_t rxm[2][4]; ///< Маски RXM0, RXM1 (SIDH, SIDL, EID8, EID0)
+  uint8_t bfpctrl;   ///< Значение регистра BFPCTRL
+  uint8_t txrtsctrl; ///< Значение регистра TXRTSCTRL
+  uint8_t cnf1;      ///< Значение регистра CNF1
+  uint8_t cnf2;      ///< Значение регистра CNF2
+  uint8_t cnf3;      ///< Значение регистра CNF3
+  uint8_t caninte;   ///< Значение регистра CANINTE
+  uint8_t rxb0ctrl;  ///< Значение регистра RXB0CTRL
+  uint8_t rxb1ctrl;  ///< Значение регистра RXB1CTRL
+};
+typedef struct MCP_Config MCP_Config;
+
+/// @brief Структура для описания отличий конфигурации от состояния микросхемы
+struct MCP_ConfigDiff
+{
+  uint8_t changed[(MCP_CONFIG_REGISTERS + 7U) / 8U]; ///< Битовая карта отличающихся регистров (по возрастанию адреса)
+  uint8_t count;                                     ///< Количество отличающихся регистров
+  bool    configMode; ///< Среди отличающихся есть регистры, доступные для записи только в режиме конфигурации
+};
+typedef struct MCP_ConfigDiff MCP_ConfigDiff;
+
+/// @brief Сравнивает конфигурацию с состоянием микросхемы
+/// @param [in] ins указатель на экземпляр драйвера
+/// @param [in] target требуемая конфигурация
+/// @param [in] current известное состояние микросхемы (например, ранее
+/// примененная конфигурация) или NULL
+/// @param [out] diff отличия конфигурации
+/// @return MCP_OK, если транзакции данных завершены успешно;
+///         иначе возвращает код ошибки
+/// @details Если current равен NULL, значения берутся из теневой копии
+/// экземпляра, а неизвестные регистры читаются пакетами READ наибольшей
+/// длины, которую позволяет MCP_BUFFER_SIZE (при размере буфера 32 байта - три
+/// транзакции). Сравнение не требует режима конфигурации, поэтому его
+/// следует выполнять до смены режима, а по полю configMode определять,
+/// нужна ли смена режима вообще.
+int32_t mcpConfigDiff(MCP_Instance* ins, const MCP_Config* target, const MCP_Config* current, MCP_ConfigDiff* diff);
+
+/// @brief Записывает отличающиеся регистры конфигурации
+/// @param [in] ins указатель на экземпляр драйвера
+/// @param [in] target требуемая конфигурация
+/// @param [in] diff отличия конфигурации (см. mcpConfigDiff)
+/// @return MCP_OK, если транзакции данных завершены успешно;
+///         иначе возвращает код ошибки
+/// @details Отличающиеся регистры с последовательными адресами
+/// записываются одним пакетом WRITE; совпадающие регистры между ними
+/// записываются повторно, если это позволяет не начинать новую транзакцию.
+/// Если diff.configMode равен true, MCP2515 должна находиться в режиме
+/// конфигурации.
+int32_t mcpConfigApply(MCP_Instance* ins, const MCP_Config* target, const MCP_ConfigDiff* diff);
+
+/// @brief Вычисляет отпечаток конфигурации
+/// @param [in] cfg конфигурация
+/// @return отпечаток (FNV-1a по битам регистров, доступным для записи)
+uint32_t mcpConfigFingerprint(const MCP_Config* cfg);
+
+/// @brief Проверяет конфигурацию микросхемы при повторном запуске
+/// @param [in] ins указатель на экземпляр драйвера
+/// @param [in] cfg требуемая конфигурация
+/// @param [in] mode требуемый режим работы (см. MCP_MODE_*)
+/// @param [in] polls наибольшее количество чтений CANSTAT при ожидании смены
+/// режима (1..255, см. mcpSetMode)
+/// @param [out] reprogrammed true, если регистры конфигурации записывались
+/// @return MCP_OK, если транзакции данных завершены успешно и микросхема
+///         работает в режиме mode;
+///         MCP_ERROR, если polls равно 0 или режим не сменился за polls
+///         чтений CANSTAT; иначе возвращает код ошибки
+/// @details Предназначена для запуска после сброса управляющего
+/// микроконтроллера без сброса MCP2515. Регистры конфигурации и CANSTAT
+/// читаются пакетами mcpRead (при размере буфера 32 байта - три транзакции),
+/// и их отпечаток сравнивается с отпечатком cfg. Если отпечатки и режим
+/// совпадают, запись не выполняется и микросхема не покидает текущий режим.
+/// Иначе отличающиеся от прочитанного образа регистры записываются
+/// (mcpConfigDiff, mcpConfigApply) без повторного чтения. В режим
+/// конфигурации MCP2515 переводится, только если среди них есть регистры,
+/// доступные для записи только в этом режиме (diff.configMode); отличия в
+/// CANINTE, BFPCTRL или TXRTSCTRL записываются без ухода с шины. Затем, если
+/// режим отличается от mode, запрашивается режим mode.
+/// @n MCP2515 переходит в режим конфигурации (и сна) только после завершения
+/// текущего фрейма: до 160 битовых интервалов CAN (расширенный фрейм с 8
+/// байтами данных, вставленными битами и межкадровым интервалом). Поэтому
+/// polls должно быть не меньше 160 * Tbit / Tread, где Tread - длительность
+/// одного чтения CANSTAT (3 байта SPI и накладные расходы на выбор
+/// микросхемы). Например, при 500 кбит/с (Tbit = 2 мкс) и SCK 8 МГц
+/// (Tread около 4 мкс) достаточно 80 чтений. Если даже 255 чтений короче
+/// фрейма (низкая скорость шины при быстром SPI), вызов повторяется после
+/// MCP_ERROR: отпечаток читается заново, и запрос режима повторяется.
+int32_t mcpConfigWarmStart(MCP_Instance* ins, const MCP_Config* cfg, uint8_t mode, uint8_t polls, bool* reprogrammed);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // CONFIG_MCP2515_H
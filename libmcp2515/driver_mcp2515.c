@@ -1,4 +1,5 @@
 #include "driver_mcp2515.h"
+#include "frame_mcp2515.h"
 
 #define OFFSET_CMD_READ 2
 #define OFFSET_CMD_READBUFFER 1
@@ -8,23 +9,370 @@
 #define OFFSET_CMD_RTS 1
 #define OFFSET_CMD_READSTATUS 1
 #define OFFSET_CMD_RXSTATUS 1
+#define OFFSET_CMD_RESET 1
+
+#define RXB_BOTH_SIZE (MCP_REG_RXB1SIDH - MCP_REG_RXB0SIDH + MCP_IMAGE_SIZE)
+
+#define KEY_SRR 0x00100000UL
+#define KEY_IDE 0x00080000UL
+
+#ifdef MCP_STATISTICS
+#  define STAT_SELECT(ins, select)       statSelect(ins, select)
+#  define STAT_COMMAND(ins, cmd, len)    statCommand(ins, cmd, len)
+#  define STAT_SEGMENTS(ins, seg, count) statSegments(ins, seg, count)
+#  define STAT_RESULT(ins, res)          statResult(ins, res)
+#  define STAT_BUFFER_ERROR(ins)         statBufferError(ins)
+
+/// @brief Отмечает начало и конец транзакции; по окончании записывает ее
+/// длительность в гистограмму
+static void statSelect(MCP_Instance* ins, bool select)
+{
+  MCP_Stats* st = &ins->stats;
+
+  if (select)
+  {
+    st->counted = false;
+    st->start   = st->cycles ? st->cycles() : 0U;
+    return;
+  }
+  if (st->counted && st->cycles)
+  {
+    uint32_t delta  = st->cycles() - st->start;
+    uint8_t  bucket = 0;
+    while ((delta > 1U) && (bucket < MCP_STAT_BUCKETS - 1U))
+    {
+      delta >>= 1;
+      bucket++;
+    }
+    st->cmd[st->current].latency[bucket]++;
+  }
+}
+
+/// @brief Учитывает вызов транспорта; первый вызов транзакции определяет команду
+static void statCommand(MCP_Instance* ins, uint8_t cmd, uint32_t len)
+{
+  MCP_Stats* st = &ins->stats;
+
+  if (!st->counted)
+  {
+    st->current = mcpCommandType(cmd);
+    st->counted = true;
+    st->cmd[st->current].calls++;
+  }
+  st->cmd[st->current].bytes += len;
+}
+
+static void statSegments(MCP_Instance* ins, const MCP_Segment* seg, uint8_t count)
+{
+  uint32_t len = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    len += seg[i].len;
+  }
+  statCommand(ins, (count && seg[0].tx) ? seg[0].tx[0] : 0U, len);
+}
+
+static int32_t statResult(MCP_Instance* ins, int32_t res)
+{
+  if (res != MCP_OK)
+  {
+    ins->stats.cmd[ins->stats.current].errors++;
+  }
+  return res;
+}
+
+static int32_t statBufferError(MCP_Instance* ins)
+{
+  ins->stats.bufferErrors++;
+  return MCP_ERROR_BUFFER;
+}
+
+void mcpStatsReset(MCP_Instance* ins)
+{
+  uint32_t (*cycles)(void) = ins->stats.cycles;
+
+  uint8_t* ptr = (uint8_t*) &ins->stats;
+  for (size_t i = 0; i < sizeof(ins->stats); i++)
+  {
+    ptr[i] = 0;
+  }
+  ins->stats.cycles = cycles;
+}
+#else
+#  define STAT_SELECT(ins, select)
+#  define STAT_COMMAND(ins, cmd, len)
+#  define STAT_SEGMENTS(ins, seg, count)
+#  define STAT_RESULT(ins, res) (res)
+#  define STAT_BUFFER_ERROR(ins) MCP_ERROR_BUFFER
+#endif  // MCP_STATISTICS
+
+/// @brief Устанавливает сигнал CS через chipSelectCtx или, если она не задана,
+/// через chipSelect. В режиме MCP_FLAG_TRANSPORT_CS ничего не делает
+static void selectChip(MCP_Instance* ins, bool select)
+{
+  STAT_SELECT(ins, select);
+  if (ins->flags & MCP_FLAG_TRANSPORT_CS)
+  {
+    return;
+  }
+  if (ins->chipSelectCtx)
+  {
+    ins->chipSelectCtx(ins->ctx, select);
+  }
+  else
+  {
+    ins->chipSelect(select);
+  }
+}
+
+/// @brief Выполняет транзакцию через transactionCtx или, если она не задана,
+/// через transaction
+static int32_t transport(MCP_Instance* ins, uint8_t* data, uint8_t len)
+{
+  if (ins->transactionCtx)
+  {
+    return ins->transactionCtx(ins->ctx, data, len);
+  }
+  return ins->transaction(data, len);
+}
+
+/// @brief Выполняет транзакцию с учетом статистики (если она включена)
+static int32_t transact(MCP_Instance* ins, uint8_t* data, uint8_t len)
+{
+  STAT_COMMAND(ins, data[0], len);
+  return STAT_RESULT(ins, transport(ins, data, len));
+}
+
+/// @brief Проверяет, может ли транспорт передавать данные без копирования в buffer
+static bool zeroCopy(const MCP_Instance* ins)
+{
+  // transfer требует нескольких вызовов за один выбор CS
+  return ins->transactionv || (ins->transfer && !(ins->flags & MCP_FLAG_TRANSPORT_CS));
+}
+
+/// @brief Выполняет обмен сегментами в пределах одного выбора CS через
+/// transactionv или, если она не задана, через transfer
+static int32_t exchange(MCP_Instance* ins, const MCP_Segment* seg, uint8_t count)
+{
+  int32_t res;
+
+  selectChip(ins, true);
+  STAT_SEGMENTS(ins, seg, count);
+  if (ins->transactionv)
+  {
+    res = ins->transactionv(ins->ctx, seg, count);
+  }
+  else
+  {
+    res = MCP_OK;
+    for (uint8_t i = 0; (i < count) && (res == MCP_OK); i++)
+    {
+      res = ins->transfer(ins->ctx, seg[i].tx, seg[i].rx, seg[i].len);
+    }
+  }
+  selectChip(ins, false);
+
+  return STAT_RESULT(ins, res);
+}
+
+/// @brief Передает заголовок команды из buffer и полезную нагрузку из памяти
+/// пользователя одной транзакцией
+static int32_t sendv(MCP_Instance* ins, uint8_t hdr, const uint8_t* data, uint8_t len)
+{
+  MCP_Segment seg[2] = {{&ins->buffer[0], NULL, hdr}, {data, NULL, len}};
+  return exchange(ins, &seg[0], len ? 2U : 1U);
+}
+
+/// @brief Передает заголовок команды из buffer и принимает ответ сразу в
+/// память пользователя одной транзакцией
+static int32_t recvv(MCP_Instance* ins, uint8_t hdr, uint8_t* data, uint8_t len)
+{
+  MCP_Segment seg[2] = {{&ins->buffer[0], NULL, hdr}, {NULL, data, len}};
+  return exchange(ins, &seg[0], len ? 2U : 1U);
+}
+
+#define REG_BFPCTRL 0x0CU
+#define REG_CANSTAT 0x0EU
+#define REG_CANCTRL 0x0FU
+#define REG_CNF3    0x28U
+#define REG_CNF1    0x2AU
+#define REG_CANINTE 0x2BU
+
+#define CANCTRL_REQOP 0xE0U
+#define REQOP_CONFIG  0x80U
+#define ADDR_MASK     0x7FU
+
+/// @brief Возвращает индекс регистра в теневой копии (зеркала CANCTRL - 0x0F)
+static uint8_t shadowIndex(uint8_t addr)
+{
+  return ((addr & 0x0FU) == REG_CANCTRL) ? (uint8_t) REG_CANCTRL : (uint8_t) (addr & ADDR_MASK);
+}
+
+/// @brief Проверяет, изменяется ли регистр только по SPI
+static bool isCacheable(uint8_t addr)
+{
+  addr = shadowIndex(addr);
+  if ((addr == REG_CANCTRL) || (addr == REG_BFPCTRL))
+  {
+    return true;
+  }
+  return (addr <= REG_CANINTE) && ((addr & 0x0FU) < REG_BFPCTRL);
+}
+
+/// @brief Проверяет, доступен ли регистр для записи только в режиме конфигурации
+static bool isConfigOnly(uint8_t addr)
+{
+  return (addr >= REG_CNF3) ? (addr <= REG_CNF1) : ((addr & 0x0FU) < REG_BFPCTRL);
+}
+
+static bool isShadowValid(const MCP_Shadow* shadow, uint8_t index)
+{
+  return (shadow->valid[index >> 3] & (1U << (index & 7U))) != 0U;
+}
+
+/// @brief Сохраняет в теневой копии записанное или прочитанное значение
+/// @param [in] written true, если значение записано (учитывается режим)
+static void shadowStore(MCP_Shadow* shadow, uint8_t addr, uint8_t value, bool written)
+{
+  uint8_t index = shadowIndex(addr);
+  uint8_t bit   = (uint8_t) (1U << (index & 7U));
+
+  if (!isCacheable(index))
+  {
+    return;
+  }
+
+  bool config = isShadowValid(shadow, REG_CANCTRL) && ((shadow->reg[REG_CANCTRL] & CANCTRL_REQOP) == REQOP_CONFIG);
+  if (written && isConfigOnly(index) && !config)
+  {
+    shadow->valid[index >> 3] &= (uint8_t) ~bit;
+    return;
+  }
+  shadow->reg[index] = value;
+  shadow->valid[index >> 3] |= bit;
+}
+
+/// @brief Читает регистры из теневой копии
+/// @return true, если все регистры кэшируемые и известны; иначе false (если
+/// среди них есть кэшируемые, учитывается промах)
+static bool shadowLoad(MCP_Instance* ins, uint8_t addr, uint8_t* data, uint8_t len)
+{
+  MCP_Shadow* shadow    = ins->shadow;
+  bool        cacheable = false;
+  bool        hit       = true;
+
+  for (uint8_t i = 0; i < len; i++)
+  {
+    uint8_t a = (uint8_t) (addr + i);
+    if (isCacheable(a))
+    {
+      cacheable = true;
+      hit       = hit && isShadowValid(shadow, shadowIndex(a));
+    }
+    else
+    {
+      hit = false;
+    }
+  }
+
+  if (!hit)
+  {
+    shadow->misses += cacheable ? 1U : 0U;
+    return false;
+  }
+
+  for (uint8_t i = 0; i < len; i++)
+  {
+    data[i] = shadow->reg[shadowIndex((uint8_t) (addr + i))];
+  }
+  shadow->hits++;
+  return true;
+}
+
+/// @brief Обновляет теневую копию после успешного чтения или записи
+static void shadowUpdate(MCP_Instance* ins, uint8_t addr, const uint8_t* data, uint8_t len, bool written)
+{
+  for (uint8_t i = 0; i < len; i++)
+  {
+    shadowStore(ins->shadow, (uint8_t) (addr + i), data[i], written);
+  }
+}
+
+void mcpShadowInvalidate(MCP_Shadow* shadow)
+{
+  for (uint8_t i = 0; i < MCP_SHADOW_SIZE / 8U; i++)
+  {
+    shadow->valid[i] = 0;
+  }
+}
+
+bool mcpShadowGet(const MCP_Shadow* shadow, uint8_t addr, uint8_t* value)
+{
+  uint8_t index = shadowIndex(addr);
+
+  if (!isCacheable(index) || !isShadowValid(shadow, index))
+  {
+    return false;
+  }
+  *value = shadow->reg[index];
+  return true;
+}
 
 int32_t mcpRead(MCP_Instance* ins, uint8_t addr, uint8_t** data, uint8_t len)
 {
   ins->buffer[0] = 0x03;
   ins->buffer[1] = addr;
 
-  len += OFFSET_CMD_READ;
-  if (len > MCP_BUFFER_SIZE)
+  if (len > MCP_BUFFER_SIZE - OFFSET_CMD_READ)
   {
-    return MCP_ERROR_BUFFER;
+    return STAT_BUFFER_ERROR(ins);
   }
 
-  ins->chipSelect(true);
-  int32_t res = ins->transaction(&ins->buffer[0], len);
-  ins->chipSelect(false);
-
   *data = &ins->buffer[OFFSET_CMD_READ];
+  if (ins->shadow && shadowLoad(ins, addr, *data, len))
+  {
+    return MCP_OK;
+  }
+
+  selectChip(ins, true);
+  int32_t res = transact(ins, &ins->buffer[0], (uint8_t) (len + OFFSET_CMD_READ));
+  selectChip(ins, false);
+
+  if (ins->shadow && (res == MCP_OK))
+  {
+    shadowUpdate(ins, addr, *data, len, false);
+  }
+  return res;
+}
+
+int32_t mcpReadInto(MCP_Instance* ins, uint8_t addr, uint8_t* data, uint8_t len)
+{
+  if (zeroCopy(ins))
+  {
+    if (ins->shadow && shadowLoad(ins, addr, data, len))
+    {
+      return MCP_OK;
+    }
+
+    ins->buffer[0] = 0x03;
+    ins->buffer[1] = addr;
+    int32_t res    = recvv(ins, OFFSET_CMD_READ, data, len);
+    if (ins->shadow && (res == MCP_OK))
+    {
+      shadowUpdate(ins, addr, data, len, false);
+    }
+    return res;
+  }
+
+  uint8_t* src;
+  int32_t  res = mcpRead(ins, addr, &src, len);
+  if (res == MCP_OK)
+  {
+    while (len--)
+    {
+      *data++ = *src++;
+    }
+  }
   return res;
 }
 
@@ -33,44 +381,173 @@ int32_t mcpReadRxBuffer(MCP_Instance* ins, MCPReadRxBufferType type, uint8_t** d
   ins->buffer[0] = (uint8_t) type;
   *len           = ((uint8_t) type & (uint8_t) 0x02) ? 8 : 13;
 
-  ins->chipSelect(true);
-  int32_t res = ins->transaction(&ins->buffer[0], *len + OFFSET_CMD_READBUFFER);
-  ins->chipSelect(false);
+  selectChip(ins, true);
+  int32_t res = transact(ins, &ins->buffer[0], *len + OFFSET_CMD_READBUFFER);
+  selectChip(ins, false);
 
   *data = &ins->buffer[OFFSET_CMD_READBUFFER];
   return res;
 }
 
+int32_t mcpReadRxBufferInto(MCP_Instance* ins, MCPReadRxBufferType type, uint8_t* data, uint8_t* len)
+{
+  if (zeroCopy(ins))
+  {
+    ins->buffer[0] = (uint8_t) type;
+    *len           = ((uint8_t) type & (uint8_t) 0x02) ? 8 : 13;
+    return recvv(ins, OFFSET_CMD_READBUFFER, data, *len);
+  }
+
+  uint8_t* src;
+  int32_t  res = mcpReadRxBuffer(ins, type, &src, len);
+  if (res == MCP_OK)
+  {
+    uint8_t l = *len;
+    while (l--)
+    {
+      *data++ = *src++;
+    }
+  }
+  return res;
+}
+
+int32_t mcpReceiveFrame(MCP_Instance* ins, uint8_t rxb, MCP_Frame* frame)
+{
+  if (rxb > 1U)
+  {
+    return MCP_ERROR;
+  }
+
+  ins->buffer[0] = (uint8_t) ((uint8_t) MCP_READRXBUFFER_RXB0SIDH | (uint8_t) (rxb << 2));
+
+  int32_t res;
+  selectChip(ins, true);
+  if ((ins->flags & (MCP_FLAG_RX_TWOPHASE | MCP_FLAG_TRANSPORT_CS)) == MCP_FLAG_RX_TWOPHASE)
+  {
+    res = transact(ins, &ins->buffer[0], MCP_IMAGE_HEADER_SIZE + OFFSET_CMD_READBUFFER);
+    if (res == MCP_OK)
+    {
+      uint8_t l = mcpImagePayloadLength(&ins->buffer[OFFSET_CMD_READBUFFER]);
+      if (l)
+      {
+        res = transact(ins, &ins->buffer[MCP_IMAGE_HEADER_SIZE + OFFSET_CMD_READBUFFER], l);
+      }
+    }
+  }
+  else
+  {
+    res = transact(ins, &ins->buffer[0], MCP_IMAGE_SIZE + OFFSET_CMD_READBUFFER);
+  }
+  selectChip(ins, false);
+
+  if (res == MCP_OK)
+  {
+    mcpImageDecode(&ins->buffer[OFFSET_CMD_READBUFFER], frame);
+  }
+  return res;
+}
+
+int32_t mcpReceiveBothFrames(MCP_Instance* ins, MCP_Frame* frames)
+{
+  uint8_t* data;
+
+  int32_t res = mcpRead(ins, MCP_REG_RXB0SIDH, &data, RXB_BOTH_SIZE);
+  if (res != MCP_OK)
+  {
+    return res;
+  }
+
+  mcpImageDecode(&data[0], &frames[0]);
+  mcpImageDecode(&data[MCP_REG_RXB1SIDH - MCP_REG_RXB0SIDH], &frames[1]);
+
+  return mcpBitModify(ins, MCP_REG_CANINTF, MCP_CANINTF_RX0IF | MCP_CANINTF_RX1IF, 0);
+}
+
 int32_t mcpWrite(MCP_Instance* ins, uint8_t addr, uint8_t* data, uint8_t len)
 {
+  if (zeroCopy(ins))
+  {
+    ins->buffer[0] = 0x02;
+    ins->buffer[1] = addr;
+    int32_t res    = sendv(ins, OFFSET_CMD_WRITE, data, len);
+    if (ins->shadow && (res == MCP_OK))
+    {
+      shadowUpdate(ins, addr, data, len, true);
+    }
+    return res;
+  }
+
   uint8_t l = len;
 
-  len += OFFSET_CMD_WRITE;
-  if (len > MCP_BUFFER_SIZE)
+  if (len > MCP_BUFFER_SIZE - OFFSET_CMD_WRITE)
   {
-    return MCP_ERROR_BUFFER;
+    return STAT_BUFFER_ERROR(ins);
   }
+  len += OFFSET_CMD_WRITE;
 
-  uint8_t* ptr = &ins->buffer[0];
-  *ptr++       = 0x02;
-  *ptr++       = addr;
+  const uint8_t* src = data;
+  uint8_t*       ptr = &ins->buffer[0];
+  *ptr++             = 0x02;
+  *ptr++             = addr;
   while (l--)
   {
-    *ptr++ = *data++;
+    *ptr++ = *src++;
   }
 
-  ins->chipSelect(true);
-  int32_t res = ins->transaction(&ins->buffer[0], len);
-  ins->chipSelect(false);
+  selectChip(ins, true);
+  int32_t res = transact(ins, &ins->buffer[0], len);
+  selectChip(ins, false);
 
+  // transaction заменяет переданные данные принятыми, поэтому копия
+  // обновляется из памяти пользователя
+  if (ins->shadow && (res == MCP_OK))
+  {
+    shadowUpdate(ins, addr, data, (uint8_t) (len - OFFSET_CMD_WRITE), true);
+  }
   return res;
 }
 
+#define REG_RXF3SIDH  0x10U
+#define REG_RXM0SIDH  0x20U
+#define FILTERS_BLOCK 12U ///< Размер блока из трех фильтров
+
+int32_t mcpWriteFilters(MCP_Instance* ins, const MCP_Filters* filters)
+{
+  // блоки RXF0..RXF2, RXF3..RXF5 и RXM0..RXM1 записываются отдельно: между
+  // ними находятся BFPCTRL, TXRTSCTRL, CANSTAT и CANCTRL (запись REQOP вывела
+  // бы микросхему из режима конфигурации), а также TEC и REC
+  static const uint8_t addr[3] = {MCP_REG_RXF0SIDH, REG_RXF3SIDH, REG_RXM0SIDH};
+  static const uint8_t size[3] = {FILTERS_BLOCK, FILTERS_BLOCK, 8U};
+  const uint8_t*       src[3]  = {&filters->rxf[0][0], &filters->rxf[3][0], &filters->rxm[0][0]};
+  uint8_t              image[FILTERS_BLOCK];
+
+  for (uint8_t i = 0; i < 3U; i++)
+  {
+    for (uint8_t j = 0; j < size[i]; j++)
+    {
+      image[j] = src[i][j];
+    }
+
+    int32_t res = mcpWrite(ins, addr[i], &image[0], size[i]);
+    if (res != MCP_OK)
+    {
+      return res;
+    }
+  }
+  return MCP_OK;
+}
+
 int32_t mcpLoadTxBuffer(MCP_Instance* ins, MCPLoadTxBufferType type, uint8_t* data)
 {
   uint8_t l   = ((uint8_t) type & (uint8_t) 0x01) ? 8 : 13;
   uint8_t len = l + OFFSET_CMD_LOADBUFFER;
 
+  if (zeroCopy(ins))
+  {
+    ins->buffer[0] = (uint8_t) type;
+    return sendv(ins, OFFSET_CMD_LOADBUFFER, data, l);
+  }
+
   uint8_t* ptr = &ins->buffer[0];
   *ptr++       = (uint8_t) type;
   while (l--)
@@ -78,13 +555,82 @@ int32_t mcpLoadTxBuffer(MCP_Instance* ins, MCPLoadTxBufferType type, uint8_t* da
     *ptr++ = *data++;
   }
 
-  ins->chipSelect(true);
-  int32_t res = ins->transaction(&ins->buffer[0], len);
-  ins->chipSelect(false);
+  selectChip(ins, true);
+  int32_t res = transact(ins, &ins->buffer[0], len);
+  selectChip(ins, false);
 
   return res;
 }
 
+int32_t mcpLoadTxFrame(MCP_Instance* ins, uint8_t txb, const MCP_Frame* frame, uint8_t* saved)
+{
+  if (txb > 2U)
+  {
+    return MCP_ERROR;
+  }
+
+  ins->buffer[0] = (uint8_t) ((uint8_t) MCP_LOADTXBUFFER_TXB0SIDH | (uint8_t) (txb << 1));
+  uint8_t l      = mcpImageEncodeHeader(frame, &ins->buffer[OFFSET_CMD_LOADBUFFER]);
+  uint8_t len    = (uint8_t) (l + MCP_IMAGE_HEADER_SIZE + OFFSET_CMD_LOADBUFFER);
+
+  int32_t res;
+  if (zeroCopy(ins))
+  {
+    res = sendv(ins, MCP_IMAGE_HEADER_SIZE + OFFSET_CMD_LOADBUFFER, &frame->data[0], l);
+  }
+  else
+  {
+    const uint8_t* src = &frame->data[0];
+    uint8_t*       ptr = &ins->buffer[MCP_IMAGE_HEADER_SIZE + OFFSET_CMD_LOADBUFFER];
+    while (l--)
+    {
+      *ptr++ = *src++;
+    }
+
+    selectChip(ins, true);
+    res = transact(ins, &ins->buffer[0], len);
+    selectChip(ins, false);
+  }
+
+  if (saved)
+  {
+    *saved = (uint8_t) (MCP_IMAGE_SIZE + OFFSET_CMD_LOADBUFFER - len);
+  }
+  return res;
+}
+
+uint32_t mcpArbitrationKey(const MCP_Frame* frame)
+{
+  uint32_t rtr = (frame->flags & MCP_FRAME_RTR) ? 1U : 0U;
+
+  if (frame->flags & MCP_FRAME_IDE)
+  {
+    return (((frame->id >> 18) & 0x7FFU) << 21) | KEY_SRR | KEY_IDE | ((frame->id & 0x3FFFFU) << 1) | rtr;
+  }
+  return ((frame->id & 0x7FFU) << 21) | (rtr << 20);
+}
+
+/// @brief Обновляет теневую копию после BIT MODIFY
+/// @details Для регистров без поддержки BIT MODIFY микросхема выполняет
+/// команду как запись (маска 0xFF)
+static void shadowModify(MCP_Shadow* shadow, uint8_t addr, uint8_t mask, uint8_t data)
+{
+  uint8_t index = shadowIndex(addr);
+
+  if (!mcpBitModifiable(addr))
+  {
+    mask = 0xFFU;
+  }
+  if (mask == 0xFFU)
+  {
+    shadowStore(shadow, index, data, true);
+  }
+  else if (isShadowValid(shadow, index))
+  {
+    shadowStore(shadow, index, (uint8_t) ((shadow->reg[index] & ~mask) | (data & mask)), true);
+  }
+}
+
 int32_t mcpBitModify(MCP_Instance* ins, uint8_t addr, uint8_t mask, uint8_t data)
 {
   ins->buffer[0] = 0x05;
@@ -92,10 +638,14 @@ int32_t mcpBitModify(MCP_Instance* ins, uint8_t addr, uint8_t mask, uint8_t data
   ins->buffer[2] = mask;
   ins->buffer[3] = data;
 
-  ins->chipSelect(true);
-  int32_t res = ins->transaction(&ins->buffer[0], OFFSET_CMD_BITMODIFY);
-  ins->chipSelect(false);
+  selectChip(ins, true);
+  int32_t res = transact(ins, &ins->buffer[0], OFFSET_CMD_BITMODIFY);
+  selectChip(ins, false);
 
+  if (ins->shadow && (res == MCP_OK))
+  {
+    shadowModify(ins->shadow, addr, mask, data);
+  }
   return res;
 }
 
@@ -103,31 +653,106 @@ int32_t mcpRTS(MCP_Instance* ins, uint8_t cmd)
 {
   ins->buffer[0] = cmd;
 
-  ins->chipSelect(true);
-  int32_t res = ins->transaction(&ins->buffer[0], OFFSET_CMD_RTS);
-  ins->chipSelect(false);
+  selectChip(ins, true);
+  int32_t res = transact(ins, &ins->buffer[0], OFFSET_CMD_RTS);
+  selectChip(ins, false);
 
   return res;
 }
 
-int32_t mcpReadStatus(MCP_Instance* ins)
+int32_t mcpReset(MCP_Instance* ins)
 {
-  ins->buffer[0] = 0xA0;
+  ins->buffer[0] = 0xC0;
 
-  ins->chipSelect(true);
-  int32_t res = ins->transaction(&ins->buffer[0], OFFSET_CMD_READSTATUS);
-  ins->chipSelect(false);
+  selectChip(ins, true);
+  int32_t res = transact(ins, &ins->buffer[0], OFFSET_CMD_RESET);
+  selectChip(ins, false);
 
-  return (res + (int32_t) ins->buffer[1]);
+  // сброс изменяет все регистры, копия заполняется заново при обращениях
+  if (ins->shadow)
+  {
+    mcpShadowInvalidate(ins->shadow);
+  }
+  return res;
 }
 
-int32_t mcpRxStatus(MCP_Instance* ins)
+int32_t mcpSetMode(MCP_Instance* ins, uint8_t mode, uint8_t polls)
+{
+  if (mode > MCP_MODE_CONFIG)
+  {
+    return MCP_ERROR;
+  }
+
+  int32_t res = mcpBitModify(ins, REG_CANCTRL, CANCTRL_REQOP, (uint8_t) (mode << 5));
+  if ((res != MCP_OK) || (polls == 0U))
+  {
+    return res;
+  }
+
+  while (polls--)
+  {
+    uint8_t* canstat;
+    res = mcpRead(ins, REG_CANSTAT, &canstat, 1);
+    if (res != MCP_OK)
+    {
+      return res;
+    }
+    if ((*canstat >> 5) == mode)
+    {
+      return MCP_OK;
+    }
+  }
+  return MCP_ERROR;
+}
+
+/// @brief Выполняет команду чтения статуса одной транзакцией
+/// @param [in] cmd команда (READ STATUS или RX STATUS)
+static int32_t readStatus(MCP_Instance* ins, uint8_t cmd, uint8_t* status, uint8_t* repeat)
+{
+  uint8_t len = (uint8_t) (OFFSET_CMD_READSTATUS + (repeat ? 2U : 1U));
+
+  ins->buffer[0] = cmd;
+  ins->buffer[1] = 0;
+  ins->buffer[2] = 0;
+
+  selectChip(ins, true);
+  int32_t res = transact(ins, &ins->buffer[0], len);
+  selectChip(ins, false);
+
+  if (res == MCP_OK)
+  {
+    if (status)
+    {
+      *status = ins->buffer[OFFSET_CMD_READSTATUS];
+    }
+    if (repeat)
+    {
+      *repeat = ins->buffer[OFFSET_CMD_READSTATUS + 1];
+    }
+  }
+  return res;
+}
+
+int32_t mcpReadStatusInto(MCP_Instance* ins, uint8_t* status, uint8_t* repeat)
+{
+  return readStatus(ins, 0xA0, status, repeat);
+}
+
+int32_t mcpRxStatusInto(MCP_Instance* ins, uint8_t* status, uint8_t* repeat)
 {
-  ins->buffer[0] = 0xB0;
+  return readStatus(ins, 0xB0, status, repeat);
+}
 
-  ins->chipSelect(true);
-  int32_t res = ins->transaction(&ins->buffer[0], OFFSET_CMD_READSTATUS);
-  ins->chipSelect(false);
+int32_t mcpReadStatus(MCP_Instance* ins)
+{
+  uint8_t status = 0;
+  int32_t res    = readStatus(ins, 0xA0, &status, NULL);
+  return (res + (int32_t) status);
+}
 
-  return (res + (int32_t) ins->buffer[1]);
+int32_t mcpRxStatus(MCP_Instance* ins)
+{
+  uint8_t status = 0;
+  int32_t res    = readStatus(ins, 0xB0, &status, NULL);
+  return (res + (int32_t) status);
 }
@@ -3,6 +3,9 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+#include "command_mcp2515.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,12 +13,114 @@ extern "C" {
 
 typedef struct MCP_Instance MCP_Instance;
 
-#define MCP_BUFFER_SIZE (uint8_t) 32U
+/// @brief Размер буферного массива экземпляра драйвера (байт)
+/// @details Может быть переопределен при сборке (например, -DMCP_BUFFER_SIZE=130),
+/// чтобы записывать или читать за одну транзакцию больше регистров (вплоть до
+/// всей карты регистров MCP2515). Допустимые значения: 32..255.
+#ifndef MCP_BUFFER_SIZE
+#  define MCP_BUFFER_SIZE 32U
+#endif
+#if (MCP_BUFFER_SIZE < 32) || (MCP_BUFFER_SIZE > 255)
+#  error "MCP_BUFFER_SIZE must be in range 32..255"
+#endif
+
+#define MCP_FLAG_RX_TWOPHASE  0x01U ///< Двухфазное чтение фрейма: заголовок, затем только DLC байт данных
+#define MCP_FLAG_TRANSPORT_CS 0x02U ///< Сигналом CS управляет транспорт: одна операция - один вызов транспорта
+
+#define MCP_REG_RXB0SIDH 0x61U ///< Адрес регистра RXB0SIDH
+#define MCP_REG_RXB1SIDH 0x71U ///< Адрес регистра RXB1SIDH
+#define MCP_REG_CANINTF  0x2CU ///< Адрес регистра флагов прерываний CANINTF
+#define MCP_REG_TXB0CTRL 0x30U ///< Адрес регистра TXB0CTRL (TXB1CTRL, TXB2CTRL - через 0x10)
+#define MCP_REG_RXF0SIDH 0x00U ///< Адрес регистра RXF0SIDH (начало блока фильтров)
+#define MCP_REG_RXM1EID0 0x27U ///< Адрес регистра RXM1EID0 (конец блока масок)
+
+#define MCP_CANINTF_RX0IF 0x01U ///< Флаг заполнения приемного буфера 0
+#define MCP_CANINTF_RX1IF 0x02U ///< Флаг заполнения приемного буфера 1
+#define MCP_CANINTF_TX0IF 0x04U ///< Флаг освобождения передающего буфера 0
+#define MCP_CANINTF_TX1IF 0x08U ///< Флаг освобождения передающего буфера 1
+#define MCP_CANINTF_TX2IF 0x10U ///< Флаг освобождения передающего буфера 2
+
+#define MCP_MODE_NORMAL     0x00U ///< Нормальный режим (значение полей REQOP и OPMOD)
+#define MCP_MODE_SLEEP      0x01U ///< Режим сна
+#define MCP_MODE_LOOPBACK   0x02U ///< Режим замкнутой петли
+#define MCP_MODE_LISTENONLY 0x03U ///< Режим только прослушивания
+#define MCP_MODE_CONFIG     0x04U ///< Режим конфигурации
 
 #define MCP_OK           (int32_t) 0   ///< Операция выполнена успешно
 #define MCP_ERROR        (int32_t)(-1) ///< Возникли неизвестные ошибки
 #define MCP_ERROR_BUFFER (int32_t)(-2) ///< Возникли ошибки, связанные с переполнением буфера
 
+#ifdef MCP_STATISTICS
+#  define MCP_STAT_BUCKETS 16U ///< Количество интервалов гистограммы длительности (log2 тактов)
+
+/// @brief Статистика одного типа команд SPI
+struct MCP_StatCommand
+{
+  uint32_t calls;                     ///< Количество транзакций (выборов CS)
+  uint32_t errors;                    ///< Количество вызовов транспорта, завершенных ошибкой
+  uint32_t bytes;                     ///< Количество переданных байт
+  uint32_t latency[MCP_STAT_BUCKETS]; ///< Гистограмма длительности: интервал n - от 2^n до 2^(n+1)-1 тактов
+};
+typedef struct MCP_StatCommand MCP_StatCommand;
+
+/// @brief Статистика экземпляра драйвера (только при сборке с MCP_STATISTICS)
+/// @details Поля изменяются только в потоке, вызывающем функции драйвера,
+/// выровненными 32-битными записями, поэтому другой поток может читать их без
+/// блокировок (значения разных полей могут относиться к соседним транзакциям).
+/// Без MCP_STATISTICS структура и весь код сбора статистики отсутствуют.
+struct MCP_Stats
+{
+  /// @brief Возвращает значение счетчика тактов (например, DWT->CYCCNT)
+  /// @details Необязательная функция (NULL - гистограмма не заполняется).
+  /// Переполнение счетчика между вызовами допускается
+  uint32_t (*cycles)(void);
+
+  MCP_StatCommand cmd[MCP_COMMAND_TYPES]; ///< Статистика по типам команд (см. MCPCommandType)
+  uint32_t        bufferErrors;          ///< Количество возвратов MCP_ERROR_BUFFER
+
+  uint32_t start;   ///< Значение счетчика тактов при выборе CS
+  uint8_t  current; ///< Тип команды текущей транзакции
+  bool     counted; ///< Текущая транзакция уже учтена
+};
+typedef struct MCP_Stats MCP_Stats;
+#endif  // MCP_STATISTICS
+
+/// @brief Структура для описания сегмента транзакции SPI
+struct MCP_Segment
+{
+  const uint8_t* tx;  ///< Передаваемые данные (NULL - передавать нули)
+  uint8_t*       rx;  ///< Сюда помещаются принимаемые данные (NULL - не сохранять)
+  uint8_t        len; ///< Количество данных (байт) в сегменте
+};
+typedef struct MCP_Segment MCP_Segment;
+
+#define MCP_SHADOW_SIZE 128U ///< Размер карты регистров MCP2515
+
+/// @brief Теневая копия регистров конфигурации MCP2515
+/// @details Подключается к экземпляру драйвера (поле shadow) и обновляется
+/// при каждой успешной записи (mcpWrite, mcpWriteFilters, mcpBitModify) и
+/// чтении (mcpRead, mcpReadInto). Чтение, все регистры которого кэшируемые и
+/// известны, выполняется без обращения к шине. Кэшируемые регистры: фильтры и
+/// маски, BFPCTRL, CANCTRL (и его зеркала), CNF1..CNF3, CANINTE. Остальные
+/// регистры (CANSTAT, CANINTF, EFLG, TEC, REC, TXRTSCTRL, TXBnCTRL, RXBnCTRL,
+/// буферы передачи и приема) изменяются микросхемой и всегда читаются по шине.
+/// @b
+/// Записанные значения сохраняются как есть, поэтому нереализованные биты
+/// нужно записывать нулями. Регистры, доступные для записи только в режиме
+/// конфигурации, обновляются, только если известное значение CANCTRL
+/// запрашивает этот режим (переход в режим должен быть завершен до записи);
+/// иначе их значения считаются неизвестными. После команды RESET или
+/// изменения регистров в обход драйвера копию необходимо сбросить
+/// (mcpShadowInvalidate).
+struct MCP_Shadow
+{
+  uint8_t  reg[MCP_SHADOW_SIZE];        ///< Значения регистров
+  uint8_t  valid[MCP_SHADOW_SIZE / 8U]; ///< Битовая карта известных значений
+  uint32_t hits;                        ///< Количество чтений без обращения к шине
+  uint32_t misses;                      ///< Количество чтений кэшируемых регистров по шине
+};
+typedef struct MCP_Shadow MCP_Shadow;
+
 /// @brief Структура для описания конкретного экземпляра драйвера
 struct MCP_Instance
 {
@@ -23,7 +128,9 @@ struct MCP_Instance
   /// @param [in] select уровень сигнала CS
   ///        true  устанавливает низкий логический уровень;
   ///        false устанавливает высокий логический уровень
-  /// @details Пользователь библиотеки должен сам реализовать данную функцию
+  /// @details Пользователь библиотеки должен сам реализовать данную функцию.
+  /// Если установлен флаг MCP_FLAG_TRANSPORT_CS, функция не вызывается и может
+  /// быть равна NULL
   void (*chipSelect)(bool select);
 
   /// @brief Вызывается, когда необходимо передать данные по интерфейсу SPI
@@ -32,9 +139,77 @@ struct MCP_Instance
   /// @return MCP_OK, если транзакция данных завершена успешно;
   ///         иначе возвращает код ошибки
   /// @details Пользователь библиотеки должен сам реализовать данную функцию.
-  /// Принимаемые по SPI данные необходимо помещать по адресу data
+  /// Принимаемые по SPI данные необходимо помещать по адресу data. @b
+  /// В режиме MCP_FLAG_RX_TWOPHASE функция может вызываться несколько раз
+  /// в пределах одного выбора CS (продолжение транзакции), поэтому она не должна
+  /// самостоятельно управлять сигналом CS
   int32_t (*transaction)(uint8_t* data, uint8_t len);
 
+  /// @brief Пользовательский контекст, передаваемый во все функции транспорта,
+  /// принимающие параметр ctx
+  /// @details Позволяет обслуживать несколько микросхем одной реализацией
+  /// транспорта (например, ctx указывает на описание шины SPI и вывода CS)
+  void* ctx;
+
+  /// @brief Аналог chipSelect, получающий пользовательский контекст ctx
+  /// @details Необязательная функция (NULL, если не используется). Если она
+  /// задана, то вызывается вместо chipSelect
+  void (*chipSelectCtx)(void* ctx, bool select);
+
+  /// @brief Аналог transaction, получающий пользовательский контекст ctx
+  /// @details Необязательная функция (NULL, если не используется). Если она
+  /// задана, то вызывается вместо transaction
+  int32_t (*transactionCtx)(void* ctx, uint8_t* data, uint8_t len);
+
+  /// @brief Вызывается, когда необходимо передать по интерфейсу SPI данные,
+  /// расположенные в нескольких сегментах памяти
+  /// @param [in] ctx пользовательский контекст (см. поле ctx)
+  /// @param [in] seg массив сегментов, передаваемых друг за другом
+  /// @param [in] count количество сегментов
+  /// @return MCP_OK, если транзакция данных завершена успешно;
+  ///         иначе возвращает код ошибки
+  /// @details Необязательная функция (NULL, если не используется). Если она
+  /// задана, то команды записи передают заголовок команды из buffer, а полезную
+  /// нагрузку - напрямую из памяти пользователя, без копирования в buffer, а
+  /// команды чтения с приемником пользователя (mcpReadInto, mcpReadRxBufferInto)
+  /// принимают данные прямо в его память. Длина записи и чтения в этом случае
+  /// не ограничивается MCP_BUFFER_SIZE
+  int32_t (*transactionv)(void* ctx, const MCP_Segment* seg, uint8_t count);
+
+  /// @brief Вызывается, когда необходимо выполнить полнодуплексный обмен по
+  /// интерфейсу SPI с раздельными буферами передачи и приема
+  /// @param [in] ctx пользовательский контекст (см. поле ctx)
+  /// @param [in] tx передаваемые данные (NULL - передавать нули)
+  /// @param [out] rx сюда помещаются принимаемые данные (NULL - не сохранять)
+  /// @param [in] len количество данных (байт), которое необходимо передать
+  /// @return MCP_OK, если транзакция данных завершена успешно;
+  ///         иначе возвращает код ошибки
+  /// @details Необязательная функция (NULL, если не используется). Если она
+  /// задана (а transactionv - нет), то заголовок команды и полезная нагрузка
+  /// передаются отдельными вызовами в пределах одного выбора CS, поэтому
+  /// функция не должна самостоятельно управлять сигналом CS. Принимаемые данные
+  /// попадают сразу в память пользователя, минуя buffer
+  int32_t (*transfer)(void* ctx, const uint8_t* tx, uint8_t* rx, uint8_t len);
+
+  /// @brief Флаги режимов работы драйвера (см. MCP_FLAG_*)
+  /// @details Если установлен флаг MCP_FLAG_TRANSPORT_CS, то каждый вызов
+  /// транспорта (transactionv, transactionCtx или transaction) должен сам
+  /// выбирать микросхему на время обмена (например, аппаратным NSS или по DMA).
+  /// Каждая операция драйвера в этом режиме выполняется ровно одним вызовом
+  /// транспорта: функция transfer не используется, а флаг MCP_FLAG_RX_TWOPHASE
+  /// игнорируется
+  uint8_t flags;
+
+  /// @brief Теневая копия регистров (см. MCP_Shadow)
+  /// @details Необязательное поле (NULL, если не используется)
+  MCP_Shadow* shadow;
+
+#ifdef MCP_STATISTICS
+  /// @brief Статистика транзакций экземпляра драйвера (см. MCP_Stats)
+  /// @details Пользователь может задать stats.cycles и читать остальные поля
+  MCP_Stats stats;
+#endif
+
   /// @brief Буферный массив для формирования и приема данных SPI протокола
   /// @details Пользователь не должен напрямую обращаться к данному полю
   uint8_t buffer[MCP_BUFFER_SIZE];
@@ -51,6 +226,17 @@ struct MCP_Instance
 /// указатель
 int32_t mcpRead(MCP_Instance* ins, uint8_t addr, uint8_t** data, uint8_t len);
 
+/// @brief Читает данные из регистров MCP2515 в память пользователя
+/// @param [in] ins указатель на экземпляр драйвера
+/// @param [in] addr адрес, начиная с которого необходимо читать данные из MCP2515
+/// @param [out] data сюда запишутся считанные данные
+/// @param [in] len количество данных (байт), которое необходимо прочитать
+/// @return MCP_OK, если транзакция данных завершена успешно;
+///         иначе возвращает код ошибки
+/// @details Если задана функция transactionv или transfer, данные принимаются
+/// по SPI сразу по адресу data. Иначе они читаются через buffer и копируются.
+int32_t mcpReadInto(MCP_Instance* ins, uint8_t addr, uint8_t* data, uint8_t len);
+
 /// @brief Возможные варианты чтения приемного буфера
 typedef enum
 {
@@ -73,6 +259,56 @@ typedef enum
 /// а на то, сколько байт было прочитано за транзакцию.
 int32_t mcpReadRxBuffer(MCP_Instance* ins, MCPReadRxBufferType type, uint8_t** data, uint8_t* len);
 
+/// @brief Читает данные из приемного буфера MCP2515 в память пользователя
+/// @param [in] ins указатель на экземпляр драйвера
+/// @param [in] type тип операции (см. MCPReadRxBufferType)
+/// @param [out] data сюда запишутся считанные данные (не менее 13 байт)
+/// @param [out] len количество данных (байт), которое было прочитано
+/// @return MCP_OK, если транзакция данных завершена успешно;
+///         иначе возвращает код ошибки
+/// @details Аналог mcpReadRxBuffer, позволяющий принимать фрейм сразу в
+/// память пользователя (например, в ячейку кольцевого буфера), если задана
+/// функция transactionv или transfer.
+int32_t mcpReadRxBufferInto(MCP_Instance* ins, MCPReadRxBufferType type, uint8_t* data, uint8_t* len);
+
+#define MCP_FRAME_IDE 0x01U ///< Фрейм с расширенным (29-битным) идентификатором
+#define MCP_FRAME_RTR 0x02U ///< Фрейм удаленного запроса (RTR)
+
+/// @brief Структура для описания CAN фрейма
+struct MCP_Frame
+{
+  uint32_t id;      ///< Идентификатор фрейма (11 или 29 бит)
+  uint8_t  flags;   ///< Флаги фрейма (см. MCP_FRAME_*)
+  uint8_t  dlc;     ///< Длина полезной нагрузки (0..8)
+  uint8_t  data[8]; ///< Полезная нагрузка фрейма
+};
+typedef struct MCP_Frame MCP_Frame;
+
+/// @brief Читает фрейм из приемного буфера MCP2515
+/// @param [in] ins указатель на экземпляр драйвера
+/// @param [in] rxb номер приемного буфера (0 или 1)
+/// @param [out] frame сюда запишется принятый фрейм
+/// @return MCP_OK, если транзакция данных завершена успешно;
+///         иначе возвращает код ошибки
+/// @details Регистры RXBnSIDH..RXBnD7 декодируются сразу из принятых по SPI
+/// данных, без промежуточного копирования. Значение DLC больше 8
+/// ограничивается значением 8. При ошибке транзакции frame не изменяется. @b
+/// Если установлен флаг MCP_FLAG_RX_TWOPHASE, то после заголовка читается
+/// только DLC байт данных (для RTR фрейма - ни одного).
+int32_t mcpReceiveFrame(MCP_Instance* ins, uint8_t rxb, MCP_Frame* frame);
+
+/// @brief Читает фреймы из обоих приемных буферов MCP2515
+/// @param [in] ins указатель на экземпляр драйвера
+/// @param [out] frames массив из двух элементов, сюда запишутся фреймы из
+///        буферов 0 и 1 соответственно
+/// @return MCP_OK, если транзакция данных завершена успешно;
+///         иначе возвращает код ошибки
+/// @details Оба буфера (RXB0SIDH..RXB1D7) читаются одной командой READ, после
+/// чего флаги RX0IF и RX1IF сбрасываются одной командой BIT MODIFY. Функцию
+/// следует вызывать, когда установлены оба флага. При ошибке чтения флаги не
+/// сбрасываются.
+int32_t mcpReceiveBothFrames(MCP_Instance* ins, MCP_Frame* frames);
+
 /// @brief Записывает данные в регистры MCP2515
 /// @param [in] ins указатель на экземпляр драйвера
 /// @param [in] addr адрес, начиная с которого необходимо записывать данные в MCP2515
@@ -80,8 +316,29 @@ int32_t mcpReadRxBuffer(MCP_Instance* ins, MCPReadRxBufferType type, uint8_t** d
 /// @param [in] len количество данных (байт), которое необходимо записать
 /// @return MCP_OK, если транзакция данных завершена успешно;
 ///         иначе возвращает код ошибки
+/// @details Если задана функция transactionv или transfer, данные передаются
+/// без копирования в buffer и MCP_ERROR_BUFFER не возвращается
 int32_t mcpWrite(MCP_Instance* ins, uint8_t addr, uint8_t* data, uint8_t len);
 
+/// @brief Структура для описания блока фильтров и масок приема (0x00..0x27)
+struct MCP_Filters
+{
+  uint8_t rxf[6][4]; ///< Фильтры RXF0..RXF5 (SIDH, SIDL, EID8, EID0)
+  uint8_t rxm[2][4]; ///< Маски RXM0, RXM1 (SIDH, SIDL, EID8, EID0)
+};
+typedef struct MCP_Filters MCP_Filters;
+
+/// @brief Записывает все фильтры и маски приема MCP2515
+/// @param [in] ins указатель на экземпляр драйвера
+/// @param [in] filters указатель на значения фильтров и масок
+/// @return MCP_OK, если транзакции данных завершены успешно;
+///         иначе возвращает код ошибки
+/// @details Запись выполняется тремя пакетами WRITE: RXF0..RXF2 (0x00..0x0B),
+/// RXF3..RXF5 (0x10..0x1B) и RXM0..RXM1 (0x20..0x27). Служебные регистры
+/// между ними (BFPCTRL, TXRTSCTRL, CANSTAT, CANCTRL, TEC, REC) не
+/// затрагиваются. MCP2515 должна находиться в режиме конфигурации.
+int32_t mcpWriteFilters(MCP_Instance* ins, const MCP_Filters* filters);
+
 /// @brief Возможные варианты записи передающего буфера
 typedef enum
 {
@@ -101,6 +358,24 @@ typedef enum
 ///         иначе возвращает код ошибки
 int32_t mcpLoadTxBuffer(MCP_Instance* ins, MCPLoadTxBufferType type, uint8_t* data);
 
+/// @brief Записывает фрейм в передающий буфер MCP2515
+/// @param [in] ins указатель на экземпляр драйвера
+/// @param [in] txb номер передающего буфера (0..2)
+/// @param [in] frame указатель на фрейм, который необходимо записать
+/// @param [out] saved сюда запишется количество байт SPI, сэкономленных
+///        относительно mcpLoadTxBuffer (может быть NULL)
+/// @return MCP_OK, если транзакция данных завершена успешно;
+///         иначе возвращает код ошибки
+/// @details Заголовок TXBnSIDH..TXBnDLC формируется из frame, после чего
+/// передаются только DLC байт полезной нагрузки (для RTR фрейма - ни одного).
+int32_t mcpLoadTxFrame(MCP_Instance* ins, uint8_t txb, const MCP_Frame* frame, uint8_t* saved);
+
+/// @brief Вычисляет ключ арбитража фрейма
+/// @param [in] frame указатель на фрейм
+/// @return поля идентификатора, SRR/RTR, IDE и RTR в порядке следования на
+///         шине: фрейм с меньшим ключом выигрывает арбитраж
+uint32_t mcpArbitrationKey(const MCP_Frame* frame);
+
 /// @brief Побитово модифицирует значение регистра MCP2515
 /// @param [in] ins указатель на экземпляр драйвера
 /// @param [in] addr адрес, содержимое которого необходимо модифицировать
@@ -110,7 +385,7 @@ int32_t mcpLoadTxBuffer(MCP_Instance* ins, MCPLoadTxBufferType type, uint8_t* da
 ///         иначе возвращает код ошибки
 int32_t mcpBitModify(MCP_Instance* ins, uint8_t addr, uint8_t mask, uint8_t data);
 
-#define MCP_RTSCMD_BUFFER0 0x80U ///< Отправить данные из передающего буфера 0
+#define MCP_RTSCMD_BUFFER0 0x81U ///< Отправить данные из передающего буфера 0
 #define MCP_RTSCMD_BUFFER1 0x82U ///< Отправить данные из передающего буфера 1
 #define MCP_RTSCMD_BUFFER2 0x84U ///< Отправить данные из передающего буфера 2
 
@@ -121,18 +396,174 @@ int32_t mcpBitModify(MCP_Instance* ins, uint8_t addr, uint8_t mask, uint8_t data
 ///         иначе возвращает код ошибки
 int32_t mcpRTS(MCP_Instance* ins, uint8_t cmd);
 
-/// @brief Команда чтения статуса MCP2515
+/// @brief Команда сброса MCP2515 (RESET)
 /// @param [in] ins указатель на экземпляр драйвера
 /// @return MCP_OK, если транзакция данных завершена успешно;
 ///         иначе возвращает код ошибки
-int32_t mcpReadStatus(MCP_Instance* ins);
+/// @details Регистры принимают значения по умолчанию, микросхема переходит в
+/// режим конфигурации. Теневая копия экземпляра (если задана) сбрасывается.
+/// После сброса микросхема не отвечает в течение 128 тактов генератора;
+/// ожидание выполняет вызывающая сторона (например, mcpSetMode с запасом
+/// чтений CANSTAT).
+int32_t mcpReset(MCP_Instance* ins);
+
+/// @brief Запрашивает режим работы MCP2515 и ожидает его установки
+/// @param [in] ins указатель на экземпляр драйвера
+/// @param [in] mode режим работы (см. MCP_MODE_*)
+/// @param [in] polls наибольшее количество чтений CANSTAT (0 - только запрос)
+/// @return MCP_OK, если режим установлен (или запрошен при polls = 0);
+///         MCP_ERROR, если mode недопустим или режим не установлен за polls
+///         чтений; иначе возвращает код ошибки
+/// @details Режим запрашивается одной командой BIT MODIFY поля REQOP
+/// регистра CANCTRL, затем поле OPMOD регистра CANSTAT читается, пока не
+/// совпадет с mode. Переход в режим конфигурации или сна происходит только
+/// после завершения передачи текущего фрейма, поэтому polls следует выбирать
+/// с учетом длительности фрейма и частоты SPI.
+int32_t mcpSetMode(MCP_Instance* ins, uint8_t mode, uint8_t polls);
+
+/// @cond
+// Бит состоит из SyncSeg (1 TQ), PropSeg (1..8), PS1 (1..8) и PS2 (2..8) -
+// всего 8..25 квантов TQ = 2 * (BRP + 1) / Fosc, BRP = 0..63. Должны
+// выполняться условия PropSeg + PS1 >= PS2 и PS2 > SJW (SJW = 1).
+#define MCP_BT_DIV_(b, n)     (2UL * (unsigned long) (b) * (n))
+#define MCP_BT_FITS_(f, b, n)                                                                              \
+  ((((unsigned long) (f) % MCP_BT_DIV_(b, n)) == 0U) && ((unsigned long) (f) / MCP_BT_DIV_(b, n) >= 1U) && \
+   ((unsigned long) (f) / MCP_BT_DIV_(b, n) <= 64U))
+#define MCP_BT_PS2LO_(n)      (((n) > 19U) ? (n) - 17U : 2U)
+#define MCP_BT_PS2HI_(n)      (((n) < 17U) ? ((n) - 1U) / 2U : 8U)
+#define MCP_BT_PS2RAW_(n, sp) ((n) - ((n) * (unsigned long) (sp) + 500U) / 1000U)
+#define MCP_BT_PS2_(n, sp)                                                         \
+  ((MCP_BT_PS2RAW_(n, sp) < MCP_BT_PS2LO_(n))   ? (unsigned long) MCP_BT_PS2LO_(n) \
+   : (MCP_BT_PS2RAW_(n, sp) > MCP_BT_PS2HI_(n)) ? (unsigned long) MCP_BT_PS2HI_(n) \
+                                                : MCP_BT_PS2RAW_(n, sp))
+#define MCP_BT_EXACT_(f, b, sp, n) \
+  (MCP_BT_FITS_(f, b, n) && (MCP_BT_PS2RAW_(n, sp) >= MCP_BT_PS2LO_(n)) && (MCP_BT_PS2RAW_(n, sp) <= MCP_BT_PS2HI_(n)))
+#define MCP_BT_TSEG1_(n, sp) ((n) - 1U - MCP_BT_PS2_(n, sp))
+#define MCP_BT_PACK_(f, b, sp, n)                                                                                        \
+  (((unsigned long) (f) / MCP_BT_DIV_(b, n) - 1U) |                                                                      \
+   ((0x80UL | ((MCP_BT_TSEG1_(n, sp) - MCP_BT_TSEG1_(n, sp) / 2U - 1U) << 3) | (MCP_BT_TSEG1_(n, sp) / 2U - 1U)) << 8) | \
+   ((MCP_BT_PS2_(n, sp) - 1U) << 16))
+/// @endcond
+
+/// @brief Вычисляет значения регистров CNF1..CNF3
+/// @param [in] osc частота генератора (Гц)
+/// @param [in] bitrate скорость CAN (бит/с)
+/// @param [in] sp точка выборки (в десятых долях процента, например 875)
+/// @return упакованные значения CNF1 (биты 0..7), CNF2 (8..15) и CNF3
+///         (16..23) или 0, если bitrate равна 0 или скорость недостижима
+///         при 8..25 квантах
+/// @details Выбирается наибольшее число квантов, при котором скорость
+/// достигается точно, а точка выборки - с точностью до половины кванта;
+/// если такого нет - наибольшее число квантов до 20 с ближайшей достижимой
+/// точкой выборки. SJW = 1, однократная выборка, PS2 задается CNF3. Макрос
+/// раскрывается в константное выражение и предназначен для постоянных
+/// конфигураций (см. также mcp2515::bitTiming).
+#define MCP_BITTIMING(osc, bitrate, sp)                                         \
+  (((bitrate) == 0U)                      ? 0UL                                 \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 25U) ? MCP_BT_PACK_(osc, bitrate, sp, 25U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 24U) ? MCP_BT_PACK_(osc, bitrate, sp, 24U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 23U) ? MCP_BT_PACK_(osc, bitrate, sp, 23U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 22U) ? MCP_BT_PACK_(osc, bitrate, sp, 22U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 21U) ? MCP_BT_PACK_(osc, bitrate, sp, 21U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 20U) ? MCP_BT_PACK_(osc, bitrate, sp, 20U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 19U) ? MCP_BT_PACK_(osc, bitrate, sp, 19U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 18U) ? MCP_BT_PACK_(osc, bitrate, sp, 18U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 17U) ? MCP_BT_PACK_(osc, bitrate, sp, 17U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 16U) ? MCP_BT_PACK_(osc, bitrate, sp, 16U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 15U) ? MCP_BT_PACK_(osc, bitrate, sp, 15U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 14U) ? MCP_BT_PACK_(osc, bitrate, sp, 14U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 13U) ? MCP_BT_PACK_(osc, bitrate, sp, 13U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 12U) ? MCP_BT_PACK_(osc, bitrate, sp, 12U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 11U) ? MCP_BT_PACK_(osc, bitrate, sp, 11U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 10U) ? MCP_BT_PACK_(osc, bitrate, sp, 10U) \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 9U)  ? MCP_BT_PACK_(osc, bitrate, sp, 9U)  \
+   : MCP_BT_EXACT_(osc, bitrate, sp, 8U)  ? MCP_BT_PACK_(osc, bitrate, sp, 8U)  \
+   : MCP_BT_FITS_(osc, bitrate, 20U)      ? MCP_BT_PACK_(osc, bitrate, sp, 20U) \
+   : MCP_BT_FITS_(osc, bitrate, 19U)      ? MCP_BT_PACK_(osc, bitrate, sp, 19U) \
+   : MCP_BT_FITS_(osc, bitrate, 18U)      ? MCP_BT_PACK_(osc, bitrate, sp, 18U) \
+   : MCP_BT_FITS_(osc, bitrate, 17U)      ? MCP_BT_PACK_(osc, bitrate, sp, 17U) \
+   : MCP_BT_FITS_(osc, bitrate, 16U)      ? MCP_BT_PACK_(osc, bitrate, sp, 16U) \
+   : MCP_BT_FITS_(osc, bitrate, 15U)      ? MCP_BT_PACK_(osc, bitrate, sp, 15U) \
+   : MCP_BT_FITS_(osc, bitrate, 14U)      ? MCP_BT_PACK_(osc, bitrate, sp, 14U) \
+   : MCP_BT_FITS_(osc, bitrate, 13U)      ? MCP_BT_PACK_(osc, bitrate, sp, 13U) \
+   : MCP_BT_FITS_(osc, bitrate, 12U)      ? MCP_BT_PACK_(osc, bitrate, sp, 12U) \
+   : MCP_BT_FITS_(osc, bitrate, 11U)      ? MCP_BT_PACK_(osc, bitrate, sp, 11U) \
+   : MCP_BT_FITS_(osc, bitrate, 10U)      ? MCP_BT_PACK_(osc, bitrate, sp, 10U) \
+   : MCP_BT_FITS_(osc, bitrate, 9U)       ? MCP_BT_PACK_(osc, bitrate, sp, 9U)  \
+   : MCP_BT_FITS_(osc, bitrate, 8U)       ? MCP_BT_PACK_(osc, bitrate, sp, 8U)  \
+                                          : 0UL)
+
+#define MCP_BITTIMING_CNF1(bt) ((uint8_t) ((bt) & 0xFFU))         ///< Значение CNF1 из результата MCP_BITTIMING
+#define MCP_BITTIMING_CNF2(bt) ((uint8_t) (((bt) >> 8) & 0xFFU))  ///< Значение CNF2 из результата MCP_BITTIMING
+#define MCP_BITTIMING_CNF3(bt) ((uint8_t) (((bt) >> 16) & 0xFFU)) ///< Значение CNF3 из результата MCP_BITTIMING
+
+#define MCP_STATUS_RX0IF  0x01U ///< READ STATUS: CANINTF.RX0IF
+#define MCP_STATUS_RX1IF  0x02U ///< READ STATUS: CANINTF.RX1IF
+#define MCP_STATUS_TX0REQ 0x04U ///< READ STATUS: TXB0CTRL.TXREQ
+#define MCP_STATUS_TX0IF  0x08U ///< READ STATUS: CANINTF.TX0IF
+#define MCP_STATUS_TX1REQ 0x10U ///< READ STATUS: TXB1CTRL.TXREQ
+#define MCP_STATUS_TX1IF  0x20U ///< READ STATUS: CANINTF.TX1IF
+#define MCP_STATUS_TX2REQ 0x40U ///< READ STATUS: TXB2CTRL.TXREQ
+#define MCP_STATUS_TX2IF  0x80U ///< READ STATUS: CANINTF.TX2IF
+
+/// @brief Команда чтения статуса MCP2515
+/// @param [in] ins указатель на экземпляр драйвера
+/// @param [out] status сюда запишется байт статуса (см. MCP_STATUS_*)
+/// @param [out] repeat сюда запишется повторно переданный байт статуса
+///        (может быть NULL - тогда повтор не тактируется)
+/// @return MCP_OK, если транзакция данных завершена успешно;
+///         иначе возвращает код ошибки (status и repeat не изменяются)
+/// @details Команда и байт статуса передаются одной транзакцией (2 байта,
+/// 3 - с повтором). Байт статуса содержит флаги приема и передачи всех
+/// буферов, поэтому его достаточно для выбора дальнейших действий.
+int32_t mcpReadStatusInto(MCP_Instance* ins, uint8_t* status, uint8_t* repeat);
 
 /// @brief Команда чтения статуса приема MCP2515
 /// @param [in] ins указатель на экземпляр драйвера
+/// @param [out] status сюда запишется байт статуса приема
+/// @param [out] repeat сюда запишется повторно переданный байт статуса
+///        (может быть NULL - тогда повтор не тактируется)
 /// @return MCP_OK, если транзакция данных завершена успешно;
+///         иначе возвращает код ошибки (status и repeat не изменяются)
+int32_t mcpRxStatusInto(MCP_Instance* ins, uint8_t* status, uint8_t* repeat);
+
+/// @brief Команда чтения статуса MCP2515
+/// @param [in] ins указатель на экземпляр драйвера
+/// @return байт статуса (см. MCP_STATUS_*), если транзакция данных завершена
+///         успешно; иначе возвращает код ошибки
+/// @details Оставлена для совместимости: код ошибки и байт статуса
+/// передаются одним значением, поэтому нулевой статус неотличим от MCP_OK.
+/// Рекомендуется mcpReadStatusInto.
+int32_t mcpReadStatus(MCP_Instance* ins);
+
+/// @brief Команда чтения статуса приема MCP2515
+/// @param [in] ins указатель на экземпляр драйвера
+/// @return байт статуса приема, если транзакция данных завершена успешно;
 ///         иначе возвращает код ошибки
+/// @details Оставлена для совместимости (см. mcpReadStatus). Рекомендуется
+/// mcpRxStatusInto.
 int32_t mcpRxStatus(MCP_Instance* ins);
 
+/// @brief Сбрасывает теневую копию регистров: все значения становятся
+/// неизвестными (счетчики сохраняются)
+/// @param [in] shadow указатель на теневую копию
+/// @details Обнуленная структура MCP_Shadow также не содержит известных значений.
+void mcpShadowInvalidate(MCP_Shadow* shadow);
+
+/// @brief Возвращает известное значение регистра из теневой копии
+/// @param [in] shadow указатель на теневую копию
+/// @param [in] addr адрес регистра
+/// @param [out] value сюда запишется значение регистра
+/// @return true, если регистр кэшируемый и его значение известно
+bool mcpShadowGet(const MCP_Shadow* shadow, uint8_t addr, uint8_t* value);
+
+#ifdef MCP_STATISTICS
+/// @brief Обнуляет статистику экземпляра драйвера (функция cycles сохраняется)
+/// @param [in] ins указатель на экземпляр драйвера
+/// @details Вызывается из того же потока, что и остальные функции драйвера
+void mcpStatsReset(MCP_Instance* ins);
+#endif
+
 #ifdef __cplusplus
 }
 #endif  // __cplusplus
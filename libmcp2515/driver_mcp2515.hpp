@@ -0,0 +1,266 @@
+#ifndef DRIVER_MCP2515_HPP
+#define DRIVER_MCP2515_HPP
+
+#include "driver_mcp2515.h"
+#include "frame_mcp2515.h"
+
+namespace mcp2515
+{
+
+namespace detail
+{
+
+constexpr uint8_t CMD_WRITE      = 0x02U;
+constexpr uint8_t CMD_READ       = 0x03U;
+constexpr uint8_t CMD_BITMODIFY  = 0x05U;
+constexpr uint8_t CMD_READSTATUS = 0xA0U;
+constexpr uint8_t CMD_RXSTATUS   = 0xB0U;
+constexpr uint8_t CMD_RESET      = 0xC0U;
+
+}  // namespace detail
+
+/// @brief Значения регистров CNF1..CNF3 (см. bitTiming)
+struct BitTiming
+{
+  uint8_t cnf1; ///< Значение регистра CNF1
+  uint8_t cnf2; ///< Значение регистра CNF2
+  uint8_t cnf3; ///< Значение регистра CNF3
+
+  /// @brief Возвращает true, если скорость достижима
+  constexpr bool valid() const { return cnf2 != 0U; }
+};
+
+/// @brief Распаковывает результат MCP_BITTIMING
+constexpr BitTiming unpackBitTiming(unsigned long bt)
+{
+  return BitTiming{MCP_BITTIMING_CNF1(bt), MCP_BITTIMING_CNF2(bt), MCP_BITTIMING_CNF3(bt)};
+}
+
+/// @brief Вычисляет значения регистров CNF1..CNF3 (см. MCP_BITTIMING)
+/// @param [in] osc частота генератора (Гц)
+/// @param [in] bitrate скорость CAN (бит/с)
+/// @param [in] samplePoint точка выборки (в десятых долях процента)
+/// @return значения регистров; если скорость недостижима, все значения 0
+/// @details Распаковывает результат MCP_BITTIMING, поэтому выбор параметров
+/// в C и C++ один и тот же. Функция вычисляется на этапе компиляции, если
+/// аргументы постоянны.
+constexpr BitTiming bitTiming(uint32_t osc, uint32_t bitrate, uint32_t samplePoint)
+{
+  return unpackBitTiming(MCP_BITTIMING(osc, bitrate, samplePoint));
+}
+
+/// @brief Экземпляр драйвера MCP2515 со статически заданным транспортом
+/// @tparam Transport класс транспорта SPI, реализующий методы
+///         void select(bool select) - установка сигнала CS (true - низкий уровень);
+///         int32_t transfer(uint8_t* data, uint8_t len) - обмен данными, принимаемые
+///         данные помещаются по адресу data
+/// @details Формирует те же команды SPI, что и driver_mcp2515.c, но вызовы
+/// транспорта разрешаются на этапе компиляции, поэтому вся последовательность
+/// обмена может быть встроена компилятором, а постоянные адреса и длины свернуты.
+template <typename Transport>
+class Device
+{
+public:
+  Device() = default;
+  explicit Device(const Transport& transport) : transport_(transport) {}
+
+  /// @brief Возвращает транспорт экземпляра драйвера
+  Transport& transport() { return transport_; }
+
+  /// @brief Читает данные из регистров MCP2515 (см. mcpRead)
+  /// @param [in] addr адрес, начиная с которого необходимо читать данные
+  /// @param [out] data сюда запишутся считанные данные (только при MCP_OK)
+  /// @param [in] len количество данных (байт), которое необходимо прочитать
+  /// @return MCP_OK, если транзакция данных завершена успешно;
+  ///         иначе возвращает код ошибки
+  int32_t read(uint8_t addr, uint8_t* data, uint8_t len)
+  {
+    if (len > MCP_BUFFER_SIZE - 2U)
+    {
+      return MCP_ERROR_BUFFER;
+    }
+
+    buffer_[0]        = detail::CMD_READ;
+    buffer_[1]        = addr;
+    const int32_t res = exchange(static_cast<uint8_t>(len + 2U));
+    if (res == MCP_OK)
+    {
+      for (uint8_t i = 0; i < len; i++)
+      {
+        data[i] = buffer_[2U + i];
+      }
+    }
+    return res;
+  }
+
+  /// @brief Читает данные из приемного буфера MCP2515 (см. mcpReadRxBuffer)
+  /// @param [in] type тип операции (см. MCPReadRxBufferType)
+  /// @param [out] data сюда запишется адрес считанных данных
+  /// @param [out] len количество данных (байт), которое было прочитано
+  /// @return MCP_OK, если транзакция данных завершена успешно;
+  ///         иначе возвращает код ошибки
+  int32_t readRxBuffer(MCPReadRxBufferType type, uint8_t** data, uint8_t* len)
+  {
+    buffer_[0] = static_cast<uint8_t>(type);
+    *len       = ((static_cast<uint8_t>(type) & 0x02U) != 0U) ? 8U : MCP_IMAGE_SIZE;
+
+    const int32_t res = exchange(static_cast<uint8_t>(*len + 1U));
+    *data             = &buffer_[1];
+    return res;
+  }
+
+  /// @brief Читает фрейм из приемного буфера MCP2515 (см. mcpReceiveFrame)
+  /// @param [in] rxb номер приемного буфера (0 или 1)
+  /// @param [out] frame сюда запишется принятый фрейм
+  /// @return MCP_OK, если транзакция данных завершена успешно;
+  ///         иначе возвращает код ошибки
+  int32_t receiveFrame(uint8_t rxb, MCP_Frame& frame)
+  {
+    if (rxb > 1U)
+    {
+      return MCP_ERROR;
+    }
+
+    buffer_[0]        = static_cast<uint8_t>(MCP_READRXBUFFER_RXB0SIDH | (rxb << 2U));
+    const int32_t res = exchange(MCP_IMAGE_SIZE + 1U);
+    if (res == MCP_OK)
+    {
+      mcpImageDecode(&buffer_[1], &frame);
+    }
+    return res;
+  }
+
+  /// @brief Записывает данные в регистры MCP2515 (см. mcpWrite)
+  /// @param [in] addr адрес, начиная с которого необходимо записывать данные
+  /// @param [in] data указатель на данные, которые необходимо записать
+  /// @param [in] len количество данных (байт), которое необходимо записать
+  /// @return MCP_OK, если транзакция данных завершена успешно;
+  ///         иначе возвращает код ошибки
+  int32_t write(uint8_t addr, const uint8_t* data, uint8_t len)
+  {
+    if (len > MCP_BUFFER_SIZE - 2U)
+    {
+      return MCP_ERROR_BUFFER;
+    }
+
+    buffer_[0] = detail::CMD_WRITE;
+    buffer_[1] = addr;
+    for (uint8_t i = 0; i < len; i++)
+    {
+      buffer_[2U + i] = data[i];
+    }
+    return exchange(static_cast<uint8_t>(len + 2U));
+  }
+
+  /// @brief Записывает данные в передающий буфер MCP2515 (см. mcpLoadTxBuffer)
+  /// @param [in] type тип операции (см. MCPLoadTxBufferType)
+  /// @param [in] data указатель на данные, которые необходимо записать
+  /// @return MCP_OK, если транзакция данных завершена успешно;
+  ///         иначе возвращает код ошибки
+  int32_t loadTxBuffer(MCPLoadTxBufferType type, const uint8_t* data)
+  {
+    const uint8_t len = ((static_cast<uint8_t>(type) & 0x01U) != 0U) ? 8U : MCP_IMAGE_SIZE;
+
+    buffer_[0] = static_cast<uint8_t>(type);
+    for (uint8_t i = 0; i < len; i++)
+    {
+      buffer_[1U + i] = data[i];
+    }
+    return exchange(static_cast<uint8_t>(len + 1U));
+  }
+
+  /// @brief Записывает фрейм в передающий буфер MCP2515 (см. mcpLoadTxFrame)
+  /// @param [in] txb номер передающего буфера (0..2)
+  /// @param [in] frame фрейм, который необходимо записать
+  /// @return MCP_OK, если транзакция данных завершена успешно;
+  ///         иначе возвращает код ошибки
+  int32_t loadTxFrame(uint8_t txb, const MCP_Frame& frame)
+  {
+    if (txb > 2U)
+    {
+      return MCP_ERROR;
+    }
+
+    buffer_[0]        = static_cast<uint8_t>(MCP_LOADTXBUFFER_TXB0SIDH | (txb << 1U));
+    const uint8_t len = mcpImageEncodeHeader(&frame, &buffer_[1]);
+    for (uint8_t i = 0; i < len; i++)
+    {
+      buffer_[1U + MCP_IMAGE_HEADER_SIZE + i] = frame.data[i];
+    }
+    return exchange(static_cast<uint8_t>(len + MCP_IMAGE_HEADER_SIZE + 1U));
+  }
+
+  /// @brief Побитово модифицирует значение регистра MCP2515 (см. mcpBitModify)
+  /// @param [in] addr адрес, содержимое которого необходимо модифицировать
+  /// @param [in] mask маска, применяемая к содержимому адреса
+  /// @param [in] data записываемое значение
+  /// @return MCP_OK, если транзакция данных завершена успешно;
+  ///         иначе возвращает код ошибки
+  int32_t bitModify(uint8_t addr, uint8_t mask, uint8_t data)
+  {
+    buffer_[0] = detail::CMD_BITMODIFY;
+    buffer_[1] = addr;
+    buffer_[2] = mask;
+    buffer_[3] = data;
+    return exchange(4U);
+  }
+
+  /// @brief Команда отправки данных из передающего буфера MCP2515 (см. mcpRTS)
+  /// @param [in] cmd тип операции (см. MCP_RTSCMD_*)
+  /// @return MCP_OK, если транзакция данных завершена успешно;
+  ///         иначе возвращает код ошибки
+  int32_t rts(uint8_t cmd)
+  {
+    buffer_[0] = cmd;
+    return exchange(1U);
+  }
+
+  /// @brief Команда сброса MCP2515 (см. mcpReset)
+  /// @return MCP_OK, если транзакция данных завершена успешно;
+  ///         иначе возвращает код ошибки
+  int32_t reset()
+  {
+    buffer_[0] = detail::CMD_RESET;
+    return exchange(1U);
+  }
+
+  /// @brief Команда чтения статуса MCP2515
+  /// @param [out] status сюда запишется байт статуса (только при MCP_OK)
+  /// @return MCP_OK, если транзакция данных завершена успешно;
+  ///         иначе возвращает код ошибки
+  int32_t readStatus(uint8_t& status) { return status2(detail::CMD_READSTATUS, status); }
+
+  /// @brief Команда чтения статуса приема MCP2515
+  /// @param [out] status сюда запишется байт статуса приема (только при MCP_OK)
+  /// @return MCP_OK, если транзакция данных завершена успешно;
+  ///         иначе возвращает код ошибки
+  int32_t rxStatus(uint8_t& status) { return status2(detail::CMD_RXSTATUS, status); }
+
+private:
+  int32_t exchange(uint8_t len)
+  {
+    transport_.select(true);
+    const int32_t res = transport_.transfer(&buffer_[0], len);
+    transport_.select(false);
+    return res;
+  }
+
+  int32_t status2(uint8_t cmd, uint8_t& status)
+  {
+    buffer_[0]        = cmd;
+    buffer_[1]        = 0;
+    const int32_t res = exchange(2U);
+    if (res == MCP_OK)
+    {
+      status = buffer_[1];
+    }
+    return res;
+  }
+
+  Transport transport_{};
+  uint8_t   buffer_[MCP_BUFFER_SIZE]{};
+};
+
+}  // namespace mcp2515
+
+#endif  // DRIVER_MCP2515_HPP
@@ -0,0 +1,106 @@
+#ifndef FRAME_MCP2515_H
+#define FRAME_MCP2515_H
+
+#include "driver_mcp2515.h"
+
+// Внутренний заголовок: упаковка фрейма в образ регистров TXBnSIDH..TXBnD7 и
+// распаковка из образа RXBnSIDH..RXBnD7. Общий для driver_mcp2515.c и
+// driver_mcp2515.hpp, поэтому функции не должны зависеть от MCP_Instance.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MCP_IMAGE_HEADER_SIZE 5U  ///< Размер заголовка: SIDH, SIDL, EID8, EID0, DLC
+#define MCP_IMAGE_SIZE        13U ///< Размер образа: заголовок и 8 байт данных
+
+#define MCP_IMAGE_SIDL_SRR  0x10U
+#define MCP_IMAGE_SIDL_IDE  0x08U
+#define MCP_IMAGE_DLC_RTR   0x40U
+#define MCP_IMAGE_DLC_MASK  0x0FU
+#define MCP_IMAGE_DLC_LIMIT 8U
+
+/// @brief Определяет по заголовку RXBnSIDH..RXBnDLC, сколько байт данных нужно прочитать
+static inline uint8_t mcpImagePayloadLength(const uint8_t* reg)
+{
+  if ((reg[1] & MCP_IMAGE_SIDL_IDE) ? (reg[4] & MCP_IMAGE_DLC_RTR) : (reg[1] & MCP_IMAGE_SIDL_SRR))
+  {
+    return 0;
+  }
+
+  uint8_t dlc = reg[4] & MCP_IMAGE_DLC_MASK;
+  return (dlc > MCP_IMAGE_DLC_LIMIT) ? (uint8_t) MCP_IMAGE_DLC_LIMIT : dlc;
+}
+
+/// @brief Декодирует фрейм из образа регистров RXBnSIDH..RXBnD7
+static inline void mcpImageDecode(const uint8_t* reg, MCP_Frame* frame)
+{
+  uint8_t  sidl = reg[1];
+  uint32_t sid  = ((uint32_t) reg[0] << 3) | ((uint32_t) sidl >> 5);
+
+  if (sidl & MCP_IMAGE_SIDL_IDE)
+  {
+    frame->id = (sid << 18) | ((uint32_t) (sidl & 0x03U) << 16) | ((uint32_t) reg[2] << 8) | (uint32_t) reg[3];
+    frame->flags = (reg[4] & MCP_IMAGE_DLC_RTR) ? (uint8_t) (MCP_FRAME_IDE | MCP_FRAME_RTR) : (uint8_t) MCP_FRAME_IDE;
+  }
+  else
+  {
+    frame->id    = sid;
+    frame->flags = (sidl & MCP_IMAGE_SIDL_SRR) ? (uint8_t) MCP_FRAME_RTR : (uint8_t) 0;
+  }
+
+  uint8_t dlc = reg[4] & MCP_IMAGE_DLC_MASK;
+  if (dlc > MCP_IMAGE_DLC_LIMIT)
+  {
+    dlc = MCP_IMAGE_DLC_LIMIT;
+  }
+  frame->dlc = dlc;
+
+  const uint8_t* src = &reg[MCP_IMAGE_HEADER_SIZE];
+  uint8_t*       dst = &frame->data[0];
+  while (dlc--)
+  {
+    *dst++ = *src++;
+  }
+}
+
+/// @brief Кодирует заголовок фрейма в образ регистров TXBnSIDH..TXBnDLC
+/// @return количество байт полезной нагрузки, которые необходимо передать
+static inline uint8_t mcpImageEncodeHeader(const MCP_Frame* frame, uint8_t* reg)
+{
+  uint32_t id = frame->id;
+
+  if (frame->flags & MCP_FRAME_IDE)
+  {
+    reg[0] = (uint8_t) (id >> 21);
+    reg[1] = (uint8_t) ((uint8_t) ((id >> 13) & 0xE0U) | MCP_IMAGE_SIDL_IDE | (uint8_t) ((id >> 16) & 0x03U));
+    reg[2] = (uint8_t) (id >> 8);
+    reg[3] = (uint8_t) id;
+  }
+  else
+  {
+    reg[0] = (uint8_t) (id >> 3);
+    reg[1] = (uint8_t) ((id << 5) & 0xE0U);
+    reg[2] = 0;
+    reg[3] = 0;
+  }
+
+  uint8_t dlc = frame->dlc;
+  if (dlc > MCP_IMAGE_DLC_LIMIT)
+  {
+    dlc = MCP_IMAGE_DLC_LIMIT;
+  }
+
+  if (frame->flags & MCP_FRAME_RTR)
+  {
+    reg[4] = (uint8_t) (dlc | MCP_IMAGE_DLC_RTR);
+    return 0;
+  }
+  reg[4] = dlc;
+  return dlc;
+}
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // FRAME_MCP2515_H
@@ -0,0 +1,21 @@
+#include "interpose_mcp2515.h"
+
+void mcpTransportInterpose(MCP_Instance* ins, const MCP_Transport* wrapper, MCP_Transport* saved)
+{
+  if (saved)
+  {
+    saved->ctx            = ins->ctx;
+    saved->chipSelectCtx  = ins->chipSelectCtx;
+    saved->transactionCtx = ins->transactionCtx;
+    saved->transactionv   = ins->transactionv;
+    saved->transfer       = ins->transfer;
+    saved->chipSelect     = ins->chipSelect;
+    saved->transaction    = ins->transaction;
+  }
+
+  ins->ctx            = wrapper->ctx;
+  ins->chipSelectCtx  = wrapper->chipSelectCtx;
+  ins->transactionCtx = wrapper->transactionCtx;
+  ins->transactionv   = ins->transactionv ? wrapper->transactionv : NULL;
+  ins->transfer       = ins->transfer ? wrapper->transfer : NULL;
+}
@@ -0,0 +1,65 @@
+#ifndef INTERPOSE_MCP2515_H
+#define INTERPOSE_MCP2515_H
+
+#include "driver_mcp2515.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Структура для описания транспорта экземпляра драйвера
+/// @details Используется обертками транспорта (spicost, trace): исходный
+/// транспорт сохраняется в эту структуру, а обертка передает ему вызовы.
+/// Функции без контекста (chipSelect, transaction) сохраняются для
+/// транспорта, не задающего функции с контекстом.
+struct MCP_Transport
+{
+  void* ctx;
+  void (*chipSelectCtx)(void* ctx, bool select);
+  int32_t (*transactionCtx)(void* ctx, uint8_t* data, uint8_t len);
+  int32_t (*transactionv)(void* ctx, const MCP_Segment* seg, uint8_t count);
+  int32_t (*transfer)(void* ctx, const uint8_t* tx, uint8_t* rx, uint8_t len);
+  void (*chipSelect)(bool select);
+  int32_t (*transaction)(uint8_t* data, uint8_t len);
+};
+typedef struct MCP_Transport MCP_Transport;
+
+/// @brief Подменяет транспорт экземпляра драйвера функциями обертки
+/// @param [in] ins указатель на экземпляр драйвера с заданным транспортом
+/// @param [in] wrapper функции обертки и ее контекст
+/// @param [out] saved сюда сохраняется исходный транспорт (NULL - не сохранять)
+/// @details Необязательные функции transactionv и transfer подменяются, только
+/// если они были заданы, поэтому выбор способа обмена драйвером не меняется.
+/// Функции без контекста экземпляра не изменяются: драйвер перестает их
+/// вызывать, так как функции обертки имеют приоритет.
+void mcpTransportInterpose(MCP_Instance* ins, const MCP_Transport* wrapper, MCP_Transport* saved);
+
+/// @brief Устанавливает сигнал CS через сохраненный транспорт (функцией с
+/// контекстом или, если она не задана, функцией без него)
+static inline void mcpTransportChipSelect(const MCP_Transport* tr, bool select)
+{
+  if (tr->chipSelectCtx)
+  {
+    tr->chipSelectCtx(tr->ctx, select);
+  }
+  else
+  {
+    tr->chipSelect(select);
+  }
+}
+
+/// @brief Выполняет транзакцию через сохраненный транспорт (функцией с
+/// контекстом или, если она не задана, функцией без него)
+static inline int32_t mcpTransportTransaction(const MCP_Transport* tr, uint8_t* data, uint8_t len)
+{
+  if (tr->transactionCtx)
+  {
+    return tr->transactionCtx(tr->ctx, data, len);
+  }
+  return tr->transaction(data, len);
+}
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // INTERPOSE_MCP2515_H
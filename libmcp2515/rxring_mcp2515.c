@@ -0,0 +1,60 @@
+#include "rxring_mcp2515.h"
+#include "atomic_mcp2515.h"
+
+#define RING_MASK (MCP_RXRING_SIZE - 1U)
+
+void mcpRxRingInit(MCP_RxRing* ring)
+{
+  ring->head      = 0;
+  ring->tail      = 0;
+  ring->overflows = 0;
+  ring->peak      = 0;
+}
+
+int32_t mcpRxRingPush(MCP_RxRing* ring, const MCP_Frame* frame)
+{
+  uint32_t head  = ring->head;
+  uint32_t count = head - mcpLoadAcquire(&ring->tail);
+
+  if (count >= MCP_RXRING_SIZE)
+  {
+    ring->overflows++;
+    return MCP_ERROR_BUFFER;
+  }
+
+  ring->frames[head & RING_MASK] = *frame;
+  mcpStoreRelease(&ring->head, head + 1U);
+
+  if (count + 1U > ring->peak)
+  {
+    ring->peak = count + 1U;
+  }
+  return MCP_OK;
+}
+
+uint32_t mcpRxRingPop(MCP_RxRing* ring, MCP_Frame* frames, uint32_t count)
+{
+  uint32_t tail      = ring->tail;
+  uint32_t available = mcpLoadAcquire(&ring->head) - tail;
+
+  if (count > available)
+  {
+    count = available;
+  }
+  for (uint32_t i = 0; i < count; i++)
+  {
+    frames[i] = ring->frames[(tail + i) & RING_MASK];
+  }
+  mcpStoreRelease(&ring->tail, tail + count);
+  return count;
+}
+
+uint32_t mcpRxRingCount(const MCP_RxRing* ring)
+{
+  return mcpLoadAcquire(&ring->head) - mcpLoadAcquire(&ring->tail);
+}
+
+void mcpRxRingReceive(void* ctx, const MCP_Frame* frame)
+{
+  (void) mcpRxRingPush((MCP_RxRing*) ctx, frame);
+}
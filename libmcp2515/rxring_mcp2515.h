@@ -0,0 +1,65 @@
+#ifndef RXRING_MCP2515_H
+#define RXRING_MCP2515_H
+
+#include "driver_mcp2515.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Размер очереди принятых фреймов. Допустимые значения: степень двойки 2..32768.
+#ifndef MCP_RXRING_SIZE
+#  define MCP_RXRING_SIZE 32U
+#endif
+#if (MCP_RXRING_SIZE < 2) || (MCP_RXRING_SIZE > 32768) || ((MCP_RXRING_SIZE & (MCP_RXRING_SIZE - 1)) != 0)
+#  error "MCP_RXRING_SIZE must be a power of two in range 2..32768"
+#endif
+
+/// @brief Структура для описания очереди принятых фреймов
+/// @details Кольцевая очередь без блокировок для одного писателя (например,
+/// цикл обслуживания в обработчике прерывания) и одного читателя
+/// (приложение). Фреймы копируются в очередь, поэтому остаются доступными
+/// после следующих вызовов драйвера. Если очередь заполнена, новый фрейм
+/// отбрасывается и увеличивается счетчик overflows.
+struct MCP_RxRing
+{
+  MCP_Frame frames[MCP_RXRING_SIZE]; ///< Фреймы
+  uint32_t  head;                    ///< Позиция записи (изменяется только писателем)
+  uint32_t  tail;                    ///< Позиция чтения (изменяется только читателем)
+  uint32_t  overflows;               ///< Количество отброшенных фреймов (изменяется только писателем)
+  uint32_t  peak;                    ///< Наибольшее количество фреймов в очереди (изменяется только писателем)
+};
+typedef struct MCP_RxRing MCP_RxRing;
+
+/// @brief Инициализирует очередь принятых фреймов
+/// @param [in] ring указатель на очередь
+void mcpRxRingInit(MCP_RxRing* ring);
+
+/// @brief Помещает фрейм в очередь (вызывается писателем)
+/// @param [in] ring указатель на очередь
+/// @param [in] frame принятый фрейм
+/// @return MCP_OK, если фрейм помещен в очередь;
+///         MCP_ERROR_BUFFER, если очередь заполнена (фрейм отброшен)
+int32_t mcpRxRingPush(MCP_RxRing* ring, const MCP_Frame* frame);
+
+/// @brief Забирает фреймы из очереди (вызывается читателем)
+/// @param [in] ring указатель на очередь
+/// @param [out] frames сюда запишутся фреймы в порядке приема
+/// @param [in] count наибольшее количество фреймов
+/// @return количество прочитанных фреймов
+/// @details Место в очереди освобождается один раз для всей пачки.
+uint32_t mcpRxRingPop(MCP_RxRing* ring, MCP_Frame* frames, uint32_t count);
+
+/// @brief Возвращает количество фреймов в очереди
+/// @param [in] ring указатель на очередь
+uint32_t mcpRxRingCount(const MCP_RxRing* ring);
+
+/// @brief Помещает фрейм в очередь; функция приема для MCP_Service
+/// @param [in] ctx указатель на очередь (MCP_RxRing)
+/// @param [in] frame принятый фрейм
+void mcpRxRingReceive(void* ctx, const MCP_Frame* frame);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // RXRING_MCP2515_H
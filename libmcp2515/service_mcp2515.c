@@ -0,0 +1,301 @@
+#include "service_mcp2515.h"
+
+#define STATUS_SIZE    2U  ///< READ STATUS: команда и байт статуса
+#define BITMODIFY_SIZE 4U  ///< BIT MODIFY: команда, адрес, маска, данные
+#define RTS_SIZE       1U  ///< RTS: команда
+#define IMAGE_SIZE     14U ///< LOAD TX / READ RX BUFFER: команда и образ буфера
+#define RXHEADER_SIZE  6U  ///< READ RX BUFFER: команда и заголовок RXBnSIDH..RXBnDLC
+
+#define TX_BUFFERS 3U
+#define TXB_STEP   0x10U ///< Расстояние между регистрами TXBnCTRL
+#define TXP_MASK   0x03U ///< Биты TXP регистра TXBnCTRL
+#define TXP_LEVELS 4U
+
+#ifdef MCP_STATISTICS
+// счетчики итерации берутся из статистики экземпляра (см. mcpService)
+#  define ACCOUNT(svc, bytes)
+#else
+#  define ACCOUNT(svc, bytes) account(svc, bytes)
+
+/// @brief Учитывает транзакцию в оценке csCycles и spiBytes
+static void account(MCP_Service* svc, uint8_t bytes)
+{
+  svc->csCycles++;
+  svc->spiBytes = (uint16_t) (svc->spiBytes + bytes);
+}
+
+/// @brief Возвращает количество байт SPI, переданных транспорту mcpReceiveFrame
+/// @param [in] frame принятый фрейм или NULL, если прием завершился ошибкой
+/// @details При ошибке двухфазного приема учитывается только заголовок: длина
+/// второй фазы неизвестна.
+static uint8_t receiveSize(const MCP_Instance* ins, const MCP_Frame* frame)
+{
+  if ((ins->flags & (MCP_FLAG_RX_TWOPHASE | MCP_FLAG_TRANSPORT_CS)) != MCP_FLAG_RX_TWOPHASE)
+  {
+    return IMAGE_SIZE;
+  }
+  if (!frame)
+  {
+    return RXHEADER_SIZE;
+  }
+  return (uint8_t) (RXHEADER_SIZE + ((frame->flags & MCP_FRAME_RTR) ? 0U : frame->dlc));
+}
+#endif  // MCP_STATISTICS
+
+static int32_t serviceRx(MCP_Service* svc, uint8_t status)
+{
+  for (uint8_t rxb = 0; rxb < 2U; rxb++)
+  {
+    if (status & (MCP_STATUS_RX0IF << rxb))
+    {
+      MCP_Frame frame;
+      int32_t   res = mcpReceiveFrame(svc->ins, rxb, &frame);
+      if (res != MCP_OK)
+      {
+        ACCOUNT(svc, receiveSize(svc->ins, NULL));
+        return res;
+      }
+      ACCOUNT(svc, receiveSize(svc->ins, &frame));
+
+      svc->rxFrames++;
+      if (svc->receive)
+      {
+        svc->receive(svc->ctx, &frame);
+      }
+    }
+  }
+  return MCP_OK;
+}
+
+/// @brief Проверяет, должен ли буфер a передаваться раньше буфера b
+static bool before(const MCP_Service* svc, uint8_t a, uint8_t b)
+{
+  if (svc->txKey[a] != svc->txKey[b])
+  {
+    return svc->txKey[a] < svc->txKey[b];
+  }
+  return (int32_t) (svc->txSeq[a] - svc->txSeq[b]) < 0;
+}
+
+/// @brief Выставляет TXP буферов так, чтобы они передавались в порядке арбитража
+/// @param [in] mask маска загруженных буферов
+/// @details Значения TXP строго убывают в порядке передачи. Текущее значение
+/// буфера сохраняется, если оно меньше значения предыдущего буфера и
+/// оставляет уровни для последующих; иначе буфер получает ближайший
+/// меньший уровень.
+static int32_t prioritize(MCP_Service* svc, uint8_t mask)
+{
+  uint8_t order[TX_BUFFERS];
+  uint8_t n = 0;
+
+  for (uint8_t txb = 0; txb < TX_BUFFERS; txb++)
+  {
+    if (mask & (1U << txb))
+    {
+      uint8_t i = n++;
+      for (; (i > 0U) && before(svc, txb, order[i - 1U]); i--)
+      {
+        order[i] = order[i - 1U];
+      }
+      order[i] = txb;
+    }
+  }
+
+  uint8_t prev = TXP_LEVELS;
+  for (uint8_t i = 0; i < n; i++)
+  {
+    uint8_t txb  = order[i];
+    uint8_t rest = (uint8_t) (n - 1U - i);
+    if ((svc->txp[txb] < prev) && (svc->txp[txb] >= rest))
+    {
+      prev = svc->txp[txb];
+      continue;
+    }
+
+    prev        = (uint8_t) (prev - 1U);
+    int32_t res = mcpBitModify(svc->ins, (uint8_t) (MCP_REG_TXB0CTRL + txb * TXB_STEP), TXP_MASK, prev);
+    ACCOUNT(svc, BITMODIFY_SIZE);
+    if (res != MCP_OK)
+    {
+      return res;
+    }
+    svc->txp[txb] = prev;
+  }
+  return MCP_OK;
+}
+
+static int32_t serviceTx(MCP_Service* svc, uint8_t status)
+{
+  uint8_t idle  = 0;
+  uint8_t flags = 0;
+
+  // в байте статуса биты TXnREQ и TXnIF каждого буфера идут парами
+  for (uint8_t txb = 0; txb < TX_BUFFERS; txb++)
+  {
+    if (!(status & (MCP_STATUS_TX0REQ << (2U * txb))))
+    {
+      idle |= (uint8_t) (1U << txb);
+    }
+    if (status & (MCP_STATUS_TX0IF << (2U * txb)))
+    {
+      flags |= (uint8_t) (MCP_CANINTF_TX0IF << txb);
+    }
+  }
+
+  for (uint8_t done = svc->pending & idle; done; done &= (uint8_t) (done - 1U))
+  {
+    svc->txFrames++;
+  }
+  svc->pending &= (uint8_t) ~idle;
+
+  int32_t res;
+  if (flags)
+  {
+    res = mcpBitModify(svc->ins, MCP_REG_CANINTF, flags, 0);
+    ACCOUNT(svc, BITMODIFY_SIZE);
+    if (res != MCP_OK)
+    {
+      return res;
+    }
+  }
+
+  uint8_t rts = 0;
+  for (uint8_t txb = 0; (txb < TX_BUFFERS) && svc->count; txb++)
+  {
+    if (idle & (1U << txb))
+    {
+      uint8_t saved = 0;
+      res           = mcpLoadTxFrame(svc->ins, txb, &svc->queue[svc->count - 1U], &saved);
+      ACCOUNT(svc, (uint8_t) (IMAGE_SIZE - saved));
+      if (res != MCP_OK)
+      {
+        return res;
+      }
+
+      svc->count--;
+      svc->txKey[txb] = svc->keys[svc->count];
+      svc->txSeq[txb] = svc->loads++;
+      rts |= (uint8_t) (1U << txb);
+    }
+  }
+
+  if (rts)
+  {
+    res = prioritize(svc, (uint8_t) (svc->pending | rts));
+    if (res != MCP_OK)
+    {
+      return res;
+    }
+  }
+
+  if (rts)
+  {
+    res = mcpRTS(svc->ins, (uint8_t) (0x80U | rts));
+    ACCOUNT(svc, RTS_SIZE);
+    if (res != MCP_OK)
+    {
+      return res;
+    }
+    svc->pending |= rts;
+  }
+  return MCP_OK;
+}
+
+void mcpServiceInit(MCP_Service* svc, MCP_Instance* ins)
+{
+  svc->ins      = ins;
+  svc->receive  = NULL;
+  svc->ctx      = NULL;
+  svc->count    = 0;
+  svc->pending  = 0;
+  svc->loads    = 0;
+  svc->status   = 0;
+  svc->csCycles = 0;
+  svc->spiBytes = 0;
+  svc->rxFrames = 0;
+  svc->txFrames = 0;
+  for (uint8_t txb = 0; txb < TX_BUFFERS; txb++)
+  {
+    svc->txKey[txb] = 0;
+    svc->txSeq[txb] = 0;
+    svc->txp[txb]   = 0;
+  }
+}
+
+int32_t mcpServiceSend(MCP_Service* svc, const MCP_Frame* frame)
+{
+  if (svc->count >= MCP_SERVICE_TXQUEUE)
+  {
+    return MCP_ERROR_BUFFER;
+  }
+
+  // очередь хранится по убыванию ключа: первым передается последний фрейм,
+  // новый фрейм встает перед фреймами с тем же ключом
+  uint32_t key = mcpArbitrationKey(frame);
+  uint8_t  i   = svc->count++;
+  for (; (i > 0U) && (svc->keys[i - 1U] <= key); i--)
+  {
+    svc->queue[i] = svc->queue[i - 1U];
+    svc->keys[i]  = svc->keys[i - 1U];
+  }
+  svc->queue[i] = *frame;
+  svc->keys[i]  = key;
+  return MCP_OK;
+}
+
+#ifdef MCP_STATISTICS
+/// @brief Суммирует транзакции и байты статистики экземпляра по всем командам
+static void statTotals(const MCP_Instance* ins, uint32_t* calls, uint32_t* bytes)
+{
+  *calls = 0;
+  *bytes = 0;
+  for (uint8_t i = 0; i < MCP_COMMAND_TYPES; i++)
+  {
+    *calls += ins->stats.cmd[i].calls;
+    *bytes += ins->stats.cmd[i].bytes;
+  }
+}
+#endif  // MCP_STATISTICS
+
+static int32_t iterate(MCP_Service* svc)
+{
+  uint8_t status;
+
+  int32_t res = mcpReadStatusInto(svc->ins, &status, NULL);
+  ACCOUNT(svc, STATUS_SIZE);
+  if (res != MCP_OK)
+  {
+    return res;
+  }
+  svc->status = status;
+
+  // прием раньше передачи: приемных буферов всего два
+  res = serviceRx(svc, status);
+  if (res != MCP_OK)
+  {
+    return res;
+  }
+  return serviceTx(svc, status);
+}
+
+int32_t mcpService(MCP_Service* svc)
+{
+  svc->csCycles = 0;
+  svc->spiBytes = 0;
+
+#ifdef MCP_STATISTICS
+  uint32_t calls;
+  uint32_t bytes;
+  uint32_t callsEnd;
+  uint32_t bytesEnd;
+
+  statTotals(svc->ins, &calls, &bytes);
+  int32_t res = iterate(svc);
+  statTotals(svc->ins, &callsEnd, &bytesEnd);
+  svc->csCycles = (uint8_t) (callsEnd - calls);
+  svc->spiBytes = (uint16_t) (bytesEnd - bytes);
+  return res;
+#else
+  return iterate(svc);
+#endif  // MCP_STATISTICS
+}
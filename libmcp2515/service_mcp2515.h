@@ -0,0 +1,94 @@
+#ifndef SERVICE_MCP2515_H
+#define SERVICE_MCP2515_H
+
+#include "driver_mcp2515.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Размер программной очереди передачи (фреймов). Допустимые значения: 1..255.
+#ifndef MCP_SERVICE_TXQUEUE
+#  define MCP_SERVICE_TXQUEUE 8U
+#endif
+#if (MCP_SERVICE_TXQUEUE < 1) || (MCP_SERVICE_TXQUEUE > 255)
+#  error "MCP_SERVICE_TXQUEUE must be in range 1..255"
+#endif
+
+/// @brief Структура для описания цикла обслуживания MCP2515
+/// @details Каждая итерация (mcpService) начинается с одной команды READ
+/// STATUS, по битам которой выполняются только необходимые транзакции:
+/// @b
+/// прием - READ RX BUFFER для каждого заполненного буфера (флаг RXnIF
+/// сбрасывается микросхемой по окончании транзакции);
+/// @b
+/// передача - один BIT MODIFY для сброса всех установленных TXnIF, LOAD TX
+/// BUFFER для каждого свободного буфера, если очередь не пуста, и одна команда
+/// RTS для всех загруженных буферов.
+/// @b
+/// Очередь передачи упорядочена по ключу арбитража (mcpArbitrationKey),
+/// фреймы с одинаковым ключом передаются в порядке постановки в очередь.
+/// Перед RTS биты TXP загруженных буферов выставляются командой BIT MODIFY
+/// так, чтобы микросхема передавала их в порядке арбитража; значение TXP
+/// буфера перезаписывается, только если текущее нарушает этот порядок.
+struct MCP_Service
+{
+  MCP_Instance* ins; ///< Экземпляр драйвера
+
+  /// @brief Вызывается для каждого принятого фрейма
+  /// @param [in] ctx пользовательский контекст (см. поле ctx)
+  /// @param [in] frame принятый фрейм
+  void (*receive)(void* ctx, const MCP_Frame* frame);
+  void* ctx; ///< Пользовательский контекст функции receive
+
+  MCP_Frame queue[MCP_SERVICE_TXQUEUE]; ///< Очередь передачи (первым передается последний фрейм)
+  uint32_t  keys[MCP_SERVICE_TXQUEUE];  ///< Ключи арбитража фреймов очереди (по убыванию)
+  uint8_t   count;                      ///< Количество фреймов в очереди
+  uint8_t   pending;                    ///< Маска буферов TXB0..TXB2, загруженных и еще не переданных
+
+  uint32_t txKey[3]; ///< Ключи арбитража фреймов в буферах TXB0..TXB2
+  uint32_t txSeq[3]; ///< Порядковые номера загрузки буферов TXB0..TXB2
+  uint8_t  txp[3];   ///< Значения TXP буферов TXB0..TXB2
+  uint32_t loads;    ///< Количество загрузок передающих буферов
+
+  uint8_t  status;   ///< Байт READ STATUS последней итерации
+  uint8_t  csCycles; ///< Количество транзакций (выборов микросхемы) последней итерации
+  uint16_t spiBytes; ///< Количество байт SPI последней итерации
+  uint32_t rxFrames; ///< Количество принятых фреймов
+  uint32_t txFrames; ///< Количество переданных фреймов
+};
+typedef struct MCP_Service MCP_Service;
+
+/// @brief Инициализирует цикл обслуживания
+/// @param [in] svc указатель на цикл обслуживания
+/// @param [in] ins указатель на экземпляр драйвера
+/// @details Функция receive и ctx сбрасываются в NULL.
+void mcpServiceInit(MCP_Service* svc, MCP_Instance* ins);
+
+/// @brief Ставит фрейм в очередь передачи
+/// @param [in] svc указатель на цикл обслуживания
+/// @param [in] frame фрейм для передачи
+/// @return MCP_OK, если фрейм поставлен в очередь;
+///         MCP_ERROR_BUFFER, если очередь заполнена
+/// @details Фрейм будет загружен в свободный передающий буфер в ближайшей
+/// итерации mcpService, если в очереди нет фреймов с меньшим ключом
+/// арбитража.
+int32_t mcpServiceSend(MCP_Service* svc, const MCP_Frame* frame);
+
+/// @brief Выполняет одну итерацию цикла обслуживания
+/// @param [in] svc указатель на цикл обслуживания
+/// @return MCP_OK, если все транзакции завершены успешно;
+///         иначе возвращает код ошибки (итерация прерывается)
+/// @details Количество транзакций и байт SPI итерации сохраняется в csCycles
+/// и spiBytes. При сборке с MCP_STATISTICS они вычисляются по приращению
+/// статистики экземпляра (ins->stats), то есть по байтам, фактически
+/// переданным транспорту. Без MCP_STATISTICS это оценка по длине каждой
+/// команды: при ошибке транзакция учитывается с длиной, переданной
+/// транспорту (для двухфазного приема - только заголовок), хотя транспорт
+/// мог прервать обмен раньше.
+int32_t mcpService(MCP_Service* svc);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // SERVICE_MCP2515_H
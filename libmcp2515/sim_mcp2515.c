@@ -0,0 +1,667 @@
+#include "sim_mcp2515.h"
+#include "command_mcp2515.h"
+#include "frame_mcp2515.h"
+
+#define CMD_RESET      0xC0U
+#define CMD_READ       0x03U
+#define CMD_WRITE      0x02U
+#define CMD_BITMODIFY  0x05U
+#define CMD_READSTATUS 0xA0U
+#define CMD_RXSTATUS   0xB0U
+#define CMD_LOADTX     0x40U ///< 0100 0abc
+#define CMD_RTS        0x80U ///< 1000 0nnn
+#define CMD_READRX     0x90U ///< 1001 0nm0
+
+#define REG_BFPCTRL   0x0CU
+#define REG_TXRTSCTRL 0x0DU
+#define REG_CANSTAT   0x0EU
+#define REG_CANCTRL   0x0FU
+#define REG_TEC       0x1CU
+#define REG_REC       0x1DU
+#define REG_RXM0      0x20U
+#define REG_RXM1      0x24U
+#define REG_CNF3      0x28U
+#define REG_CNF1      0x2AU
+#define REG_CANINTE   0x2BU
+#define REG_CANINTF   0x2CU
+#define REG_EFLG      0x2DU
+#define REG_TXB0CTRL  0x30U
+#define REG_RXB0CTRL  0x60U
+#define REG_RXB1CTRL  0x70U
+
+#define ADDR_NONE 0xFFU ///< Нет адреса назначения (недопустимая команда LOAD TX BUFFER)
+
+#define TXB_STEP 0x10U ///< Расстояние между передающими (и приемными) буферами
+#define TXB_SIDL 0x02U ///< Смещение TXBnSIDL от TXBnCTRL
+#define TXB_DLC  0x05U ///< Смещение TXBnDLC от TXBnCTRL
+
+#define TXBCTRL_TXREQ 0x08U
+#define TXBCTRL_TXP   0x03U
+#define RXBCTRL_RXM   0x60U
+#define RXBCTRL_RXRTR 0x08U
+#define RXBCTRL_BUKT  0x04U
+#define RXBCTRL_BUKT1 0x02U
+
+#define INTF_RX0IF 0x01U
+#define INTF_RX1IF 0x02U
+#define INTF_TX0IF 0x04U
+#define INTF_ERRIF 0x20U
+#define INTF_WAKIF 0x40U
+
+#define EFLG_RX0OVR 0x40U
+#define EFLG_RX1OVR 0x80U
+
+#define CANCTRL_RESET 0x87U
+#define CANSTAT_RESET 0x80U
+
+/// @brief Приводит адреса зеркал CANSTAT/CANCTRL (0xXE/0xXF) к 0x0E/0x0F
+static uint8_t canonical(uint8_t addr)
+{
+  addr &= (uint8_t) (MCP_SIM_REGISTERS - 1U);
+  return ((addr & 0x0EU) == 0x0EU) ? (uint8_t) (addr & 0x0FU) : addr;
+}
+
+/// @brief Проверяет, относится ли адрес к фильтрам и маскам приема
+static bool isFilter(uint8_t addr)
+{
+  return (addr < REG_CNF3) && ((addr & 0x0FU) < REG_BFPCTRL);
+}
+
+/// @brief Возвращает маску битов регистра, доступных для записи по SPI
+static uint8_t writableMask(const MCP_Sim* sim, uint8_t addr)
+{
+  bool config = (mcpSimMode(sim) == MCP_MODE_CONFIG);
+
+  if (isFilter(addr))
+  {
+    return config ? 0xFFU : 0x00U;
+  }
+  if ((addr >= REG_RXB0CTRL + 1U) && ((addr & 0x0FU) != 0U))
+  {
+    return 0x00U;  // приемные буферы доступны только для чтения
+  }
+  if ((addr > REG_TXB0CTRL) && (addr < REG_RXB0CTRL))
+  {
+    // нереализованные биты TXBnSIDL и TXBnDLC всегда читаются как 0
+    if ((addr & 0x0FU) == TXB_SIDL)
+    {
+      return 0xEBU;
+    }
+    if ((addr & 0x0FU) == TXB_DLC)
+    {
+      return 0x4FU;
+    }
+  }
+
+  switch (addr)
+  {
+  case REG_CANSTAT:
+  case REG_TEC:
+  case REG_REC:
+    return 0x00U;
+  case REG_TXRTSCTRL:
+    return config ? 0x07U : 0x00U;
+  case REG_CNF3:
+  case REG_CNF3 + 1U:
+  case REG_CNF1:
+    return config ? 0xFFU : 0x00U;
+  case REG_EFLG:
+    return EFLG_RX0OVR | EFLG_RX1OVR;
+  case REG_TXB0CTRL:
+  case REG_TXB0CTRL + TXB_STEP:
+  case REG_TXB0CTRL + 2U * TXB_STEP:
+    return TXBCTRL_TXREQ | TXBCTRL_TXP;
+  case REG_RXB0CTRL:
+    return RXBCTRL_RXM | RXBCTRL_BUKT;
+  case REG_RXB1CTRL:
+    return RXBCTRL_RXM;
+  default:
+    return 0xFFU;
+  }
+}
+
+/// @brief Вычисляет код прерывания ICOD для регистра CANSTAT
+static uint8_t interruptCode(const MCP_Sim* sim)
+{
+  uint8_t active = sim->reg[REG_CANINTF] & sim->reg[REG_CANINTE];
+
+  if (active & INTF_ERRIF)
+  {
+    return 1U;
+  }
+  if (active & INTF_WAKIF)
+  {
+    return 2U;
+  }
+  for (uint8_t i = 0; i < 3U; i++)
+  {
+    if (active & (uint8_t) (INTF_TX0IF << i))
+    {
+      return (uint8_t) (3U + i);
+    }
+  }
+  if (active & INTF_RX0IF)
+  {
+    return 6U;
+  }
+  if (active & INTF_RX1IF)
+  {
+    return 7U;
+  }
+  return 0U;
+}
+
+static uint8_t readRegister(const MCP_Sim* sim, uint8_t addr)
+{
+  addr = canonical(addr);
+  if (addr == REG_CANSTAT)
+  {
+    return (uint8_t) ((sim->reg[REG_CANSTAT] & 0xF1U) | (uint8_t) (interruptCode(sim) << 1));
+  }
+  return sim->reg[addr];
+}
+
+static void writeRegister(MCP_Sim* sim, uint8_t addr, uint8_t mask, uint8_t value)
+{
+  addr = canonical(addr);
+  mask &= writableMask(sim, addr);
+  sim->reg[addr] = (uint8_t) ((sim->reg[addr] & (uint8_t) ~mask) | (value & mask));
+
+  if (addr == REG_CANCTRL)
+  {
+    // смена режима выполняется сразу (шина считается свободной)
+    sim->reg[REG_CANSTAT] = (uint8_t) ((sim->reg[REG_CANSTAT] & 0x1FU) | (sim->reg[REG_CANCTRL] & 0xE0U));
+  }
+}
+
+static uint8_t readStatus(const MCP_Sim* sim)
+{
+  uint8_t intf   = sim->reg[REG_CANINTF];
+  uint8_t status = intf & (INTF_RX0IF | INTF_RX1IF);
+
+  for (uint8_t i = 0; i < 3U; i++)
+  {
+    if (sim->reg[REG_TXB0CTRL + i * TXB_STEP] & TXBCTRL_TXREQ)
+    {
+      status |= (uint8_t) (0x04U << (2U * i));
+    }
+    if (intf & (uint8_t) (INTF_TX0IF << i))
+    {
+      status |= (uint8_t) (0x08U << (2U * i));
+    }
+  }
+  return status;
+}
+
+static uint8_t rxStatus(const MCP_Sim* sim)
+{
+  uint8_t intf = sim->reg[REG_CANINTF] & (INTF_RX0IF | INTF_RX1IF);
+  if (!intf)
+  {
+    return 0;
+  }
+
+  uint8_t status = (uint8_t) (intf << 6);
+  uint8_t base   = (intf & INTF_RX0IF) ? REG_RXB0CTRL : REG_RXB1CTRL;
+  uint8_t ctrl   = sim->reg[base];
+
+  if (sim->reg[base + 2U] & MCP_IMAGE_SIDL_IDE)
+  {
+    status |= 0x10U;
+  }
+  if (ctrl & RXBCTRL_RXRTR)
+  {
+    status |= 0x08U;
+  }
+  if (base == REG_RXB0CTRL)
+  {
+    status |= ctrl & 0x01U;
+  }
+  else
+  {
+    // FILHIT 0/1 в RXB1 возможен только при переносе из RXB0
+    uint8_t hit = ctrl & 0x07U;
+    status |= (hit < 2U) ? (uint8_t) (hit + 6U) : hit;
+  }
+  return status;
+}
+
+static void resetRegisters(MCP_Sim* sim)
+{
+  for (uint8_t i = 0; i < MCP_SIM_REGISTERS; i++)
+  {
+    sim->reg[i] = 0;
+  }
+  sim->reg[REG_CANCTRL] = CANCTRL_RESET;
+  sim->reg[REG_CANSTAT] = CANSTAT_RESET;
+}
+
+/// @brief Кодирует заголовок принятого фрейма в формат регистров RXBnSIDH..RXBnDLC
+static void encodeHeader(const MCP_Frame* frame, uint8_t* img)
+{
+  mcpImageEncodeHeader(frame, img);
+
+  // принятый DLC сохраняется без ограничения; RTR стандартного фрейма
+  // отмечается битом SRR, расширенного - битом RTR регистра DLC
+  img[4] = frame->dlc & MCP_IMAGE_DLC_MASK;
+  if (frame->flags & MCP_FRAME_RTR)
+  {
+    if (frame->flags & MCP_FRAME_IDE)
+    {
+      img[4] |= MCP_IMAGE_DLC_RTR;
+    }
+    else
+    {
+      img[1] |= MCP_IMAGE_SIDL_SRR;
+    }
+  }
+}
+
+/// @brief Формирует ключ фильтрации (SIDH, SIDL, EID8, EID0) из заголовка
+static void filterKey(const MCP_Frame* frame, const uint8_t* img, uint8_t* key)
+{
+  key[0] = img[0];
+  key[1] = img[1];
+  if (frame->flags & MCP_FRAME_IDE)
+  {
+    key[2] = img[2];
+    key[3] = img[3];
+  }
+  else
+  {
+    // для стандартных фреймов биты EID фильтров применяются к байтам данных 0 и 1
+    key[2] = (frame->dlc > 0U) ? frame->data[0] : 0U;
+    key[3] = (frame->dlc > 1U) ? frame->data[1] : 0U;
+  }
+}
+
+static bool filterMatch(const MCP_Sim* sim, uint8_t filter, uint8_t mask, const uint8_t* img)
+{
+  const uint8_t* f = &sim->reg[filter];
+  const uint8_t* m = &sim->reg[mask];
+
+  if ((f[1] ^ img[1]) & MCP_IMAGE_SIDL_IDE)
+  {
+    return false;
+  }
+
+  uint8_t sidl = (img[1] & MCP_IMAGE_SIDL_IDE) ? 0xE3U : 0xE0U;
+  return (((f[0] ^ img[0]) & m[0]) == 0U) && (((f[1] ^ img[1]) & m[1] & sidl) == 0U) &&
+         (((f[2] ^ img[2]) & m[2]) == 0U) && (((f[3] ^ img[3]) & m[3]) == 0U);
+}
+
+/// @brief Подбирает фильтр приемного буфера
+/// @return номер совпавшего фильтра или -1
+static int8_t acceptFilter(const MCP_Sim* sim, uint8_t rxb, const uint8_t* img)
+{
+  static const uint8_t filters[6] = {0x00, 0x04, 0x08, 0x10, 0x14, 0x18};
+
+  uint8_t ctrl = sim->reg[rxb ? REG_RXB1CTRL : REG_RXB0CTRL];
+  if ((ctrl & RXBCTRL_RXM) == RXBCTRL_RXM)
+  {
+    return (int8_t) (rxb ? 2 : 0);  // фильтры отключены, принимается все
+  }
+
+  uint8_t first = rxb ? 2U : 0U;
+  uint8_t last  = rxb ? 6U : 2U;
+  for (uint8_t i = first; i < last; i++)
+  {
+    if (filterMatch(sim, filters[i], rxb ? REG_RXM1 : REG_RXM0, img))
+    {
+      return (int8_t) i;
+    }
+  }
+  return -1;
+}
+
+static void storeFrame(MCP_Sim* sim, uint8_t rxb, uint8_t hit, const MCP_Frame* frame, const uint8_t* img)
+{
+  uint8_t  base = (uint8_t) (REG_RXB0CTRL + rxb * TXB_STEP);
+  uint8_t* r    = &sim->reg[base];
+
+  if (rxb == 0U)
+  {
+    r[0] = (uint8_t) ((r[0] & (RXBCTRL_RXM | RXBCTRL_BUKT)) | ((r[0] & RXBCTRL_BUKT) ? RXBCTRL_BUKT1 : 0U) | (hit & 0x01U));
+  }
+  else
+  {
+    r[0] = (uint8_t) ((r[0] & RXBCTRL_RXM) | (hit & 0x07U));
+  }
+  if (frame->flags & MCP_FRAME_RTR)
+  {
+    r[0] |= RXBCTRL_RXRTR;
+  }
+
+  // записываются заголовок и только принятые байты данных
+  uint8_t len = mcpImagePayloadLength(img);
+  for (uint8_t i = 0; i < MCP_IMAGE_HEADER_SIZE; i++)
+  {
+    r[1U + i] = img[i];
+  }
+  for (uint8_t i = 0; i < len; i++)
+  {
+    r[1U + MCP_IMAGE_HEADER_SIZE + i] = frame->data[i];
+  }
+
+  sim->reg[REG_CANINTF] |= rxb ? INTF_RX1IF : INTF_RX0IF;
+  sim->rxFrames++;
+}
+
+static void overflow(MCP_Sim* sim, uint8_t flag)
+{
+  sim->reg[REG_EFLG] |= flag;
+  sim->reg[REG_CANINTF] |= INTF_ERRIF;
+  sim->rxDropped++;
+}
+
+/// @brief Принимает фрейм без проверки режима работы
+static bool receive(MCP_Sim* sim, const MCP_Frame* frame)
+{
+  uint8_t img[MCP_IMAGE_HEADER_SIZE];
+  uint8_t key[4];
+  encodeHeader(frame, img);
+  filterKey(frame, img, key);
+
+  int8_t hit0 = acceptFilter(sim, 0, key);
+  if (hit0 >= 0)
+  {
+    if (!(sim->reg[REG_CANINTF] & INTF_RX0IF))
+    {
+      storeFrame(sim, 0, (uint8_t) hit0, frame, img);
+      return true;
+    }
+    // фрейм, принятый фильтрами RXB0, попадает в RXB1 только при переносе
+    // (BUKT), независимо от фильтров RXB1; иначе он теряется
+    if (!(sim->reg[REG_RXB0CTRL] & RXBCTRL_BUKT))
+    {
+      overflow(sim, EFLG_RX0OVR);
+      return false;
+    }
+    if (!(sim->reg[REG_CANINTF] & INTF_RX1IF))
+    {
+      storeFrame(sim, 1, (uint8_t) hit0, frame, img);
+      return true;
+    }
+    overflow(sim, EFLG_RX1OVR);
+    return false;
+  }
+
+  int8_t hit1 = acceptFilter(sim, 1, key);
+  if (hit1 < 0)
+  {
+    return false;
+  }
+  if (!(sim->reg[REG_CANINTF] & INTF_RX1IF))
+  {
+    storeFrame(sim, 1, (uint8_t) hit1, frame, img);
+    return true;
+  }
+  overflow(sim, EFLG_RX1OVR);
+  return false;
+}
+
+/// @brief Обрабатывает запросы передачи в режиме замкнутой петли
+static void loopback(MCP_Sim* sim)
+{
+  if (mcpSimMode(sim) != MCP_MODE_LOOPBACK)
+  {
+    return;
+  }
+
+  int8_t txb;
+  while ((txb = mcpSimPendingTx(sim)) >= 0)
+  {
+    MCP_Frame frame;
+    mcpSimTxFrame(sim, (uint8_t) txb, &frame);
+    mcpSimTxDone(sim, (uint8_t) txb);
+    receive(sim, &frame);
+  }
+}
+
+/// @brief Обрабатывает один байт обмена SPI
+/// @return байт, выдаваемый микросхемой на линию MISO
+static uint8_t exchangeByte(MCP_Sim* sim, uint8_t in)
+{
+  uint8_t out   = 0;
+  uint8_t phase = sim->phase;
+
+  sim->spiBytes++;
+  if (phase < 0xFFU)
+  {
+    sim->phase++;
+  }
+
+  if (phase == 0U)
+  {
+    sim->cmd = in;
+    if (in == CMD_RESET)
+    {
+      resetRegisters(sim);
+    }
+    else if ((in & 0xF8U) == CMD_LOADTX)
+    {
+      static const uint8_t start[8] = {0x31, 0x36, 0x41, 0x46, 0x51, 0x56, ADDR_NONE, ADDR_NONE};
+      sim->addr                     = start[in & 0x07U];
+    }
+    else if ((in & 0xF9U) == CMD_READRX)
+    {
+      uint8_t n = (uint8_t) ((in >> 2) & 0x01U);
+      sim->addr = (uint8_t) (0x61U + n * TXB_STEP + ((in & 0x02U) ? 5U : 0U));
+      sim->rxRead |= (uint8_t) (INTF_RX0IF << n);
+    }
+    else if ((in & 0xF8U) == CMD_RTS)
+    {
+      for (uint8_t i = 0; i < 3U; i++)
+      {
+        if (in & (1U << i))
+        {
+          sim->reg[REG_TXB0CTRL + i * TXB_STEP] |= TXBCTRL_TXREQ;
+        }
+      }
+    }
+    return out;
+  }
+
+  uint8_t cmd = sim->cmd;
+  if ((cmd == CMD_READ) || (cmd == CMD_WRITE) || (cmd == CMD_BITMODIFY))
+  {
+    if (phase == 1U)
+    {
+      sim->addr = in;
+    }
+    else if (cmd == CMD_READ)
+    {
+      out       = readRegister(sim, sim->addr);
+      sim->addr = (uint8_t) ((sim->addr + 1U) & (MCP_SIM_REGISTERS - 1U));
+    }
+    else if (cmd == CMD_WRITE)
+    {
+      writeRegister(sim, sim->addr, 0xFFU, in);
+      sim->addr = (uint8_t) ((sim->addr + 1U) & (MCP_SIM_REGISTERS - 1U));
+    }
+    else if (phase == 2U)
+    {
+      sim->mask = in;
+    }
+    else if (phase == 3U)
+    {
+      uint8_t addr = canonical(sim->addr);
+      writeRegister(sim, addr, mcpBitModifiable(addr) ? sim->mask : 0xFFU, in);
+    }
+  }
+  else if ((cmd & 0xF8U) == CMD_LOADTX)
+  {
+    // данные недопустимой команды (0x46, 0x47) отбрасываются; запись не
+    // выходит за пределы TXBnD7
+    if ((sim->addr != ADDR_NONE) && ((sim->addr & 0x0FU) != 0x0EU))
+    {
+      writeRegister(sim, sim->addr++, 0xFFU, in);
+    }
+  }
+  else if ((cmd & 0xF9U) == CMD_READRX)
+  {
+    out       = readRegister(sim, sim->addr);
+    sim->addr = (uint8_t) ((sim->addr + 1U) & (MCP_SIM_REGISTERS - 1U));
+  }
+  else if (cmd == CMD_READSTATUS)
+  {
+    out = readStatus(sim);
+  }
+  else if (cmd == CMD_RXSTATUS)
+  {
+    out = rxStatus(sim);
+  }
+  return out;
+}
+
+void mcpSimInit(MCP_Sim* sim)
+{
+  resetRegisters(sim);
+  sim->selected  = false;
+  sim->phase     = 0;
+  sim->cmd       = 0;
+  sim->addr      = 0;
+  sim->mask      = 0;
+  sim->rxRead    = 0;
+  sim->spiBytes  = 0;
+  sim->csCycles  = 0;
+  sim->txFrames  = 0;
+  sim->rxFrames  = 0;
+  sim->rxDropped = 0;
+}
+
+void mcpSimAttach(MCP_Sim* sim, MCP_Instance* ins)
+{
+  ins->ctx            = sim;
+  ins->chipSelectCtx  = mcpSimChipSelect;
+  ins->transactionCtx = mcpSimTransaction;
+}
+
+void mcpSimChipSelect(void* ctx, bool select)
+{
+  MCP_Sim* sim = (MCP_Sim*) ctx;
+
+  if (select == sim->selected)
+  {
+    return;
+  }
+  sim->selected = select;
+
+  if (select)
+  {
+    sim->phase  = 0;
+    sim->rxRead = 0;
+    sim->csCycles++;
+    return;
+  }
+
+  // по окончании READ RX BUFFER флаг RXnIF сбрасывается автоматически
+  sim->reg[REG_CANINTF] &= (uint8_t) ~sim->rxRead;
+  sim->rxRead = 0;
+  loopback(sim);
+}
+
+int32_t mcpSimTransaction(void* ctx, uint8_t* data, uint8_t len)
+{
+  return mcpSimTransfer(ctx, data, data, len);
+}
+
+int32_t mcpSimTransfer(void* ctx, const uint8_t* tx, uint8_t* rx, uint8_t len)
+{
+  MCP_Sim* sim    = (MCP_Sim*) ctx;
+  bool     framed = !sim->selected;
+
+  if (framed)
+  {
+    mcpSimChipSelect(ctx, true);
+  }
+  for (uint8_t i = 0; i < len; i++)
+  {
+    uint8_t out = exchangeByte(sim, tx ? tx[i] : 0U);
+    if (rx)
+    {
+      rx[i] = out;
+    }
+  }
+  if (framed)
+  {
+    mcpSimChipSelect(ctx, false);
+  }
+  return MCP_OK;
+}
+
+int32_t mcpSimTransactionv(void* ctx, const MCP_Segment* seg, uint8_t count)
+{
+  MCP_Sim* sim    = (MCP_Sim*) ctx;
+  bool     framed = !sim->selected;
+
+  if (framed)
+  {
+    mcpSimChipSelect(ctx, true);
+  }
+  for (uint8_t i = 0; i < count; i++)
+  {
+    mcpSimTransfer(ctx, seg[i].tx, seg[i].rx, seg[i].len);
+  }
+  if (framed)
+  {
+    mcpSimChipSelect(ctx, false);
+  }
+  return MCP_OK;
+}
+
+uint8_t mcpSimMode(const MCP_Sim* sim)
+{
+  return (uint8_t) (sim->reg[REG_CANSTAT] >> 5);
+}
+
+bool mcpSimInterrupt(const MCP_Sim* sim)
+{
+  return (sim->reg[REG_CANINTF] & sim->reg[REG_CANINTE]) != 0U;
+}
+
+bool mcpSimReceive(MCP_Sim* sim, const MCP_Frame* frame)
+{
+  uint8_t mode = mcpSimMode(sim);
+  if ((mode != MCP_MODE_NORMAL) && (mode != MCP_MODE_LISTENONLY))
+  {
+    return false;
+  }
+  return receive(sim, frame);
+}
+
+int8_t mcpSimPendingTx(const MCP_Sim* sim)
+{
+  int8_t  best     = -1;
+  uint8_t priority = 0;
+
+  for (uint8_t i = 0; i < 3U; i++)
+  {
+    uint8_t ctrl = sim->reg[REG_TXB0CTRL + i * TXB_STEP];
+    if ((ctrl & TXBCTRL_TXREQ) && ((best < 0) || ((ctrl & TXBCTRL_TXP) >= priority)))
+    {
+      best     = (int8_t) i;
+      priority = ctrl & TXBCTRL_TXP;
+    }
+  }
+  return best;
+}
+
+void mcpSimTxFrame(const MCP_Sim* sim, uint8_t txb, MCP_Frame* frame)
+{
+  const uint8_t* r = &sim->reg[REG_TXB0CTRL + 1U + txb * TXB_STEP];
+
+  mcpImageDecode(r, frame);
+  // в передающем буфере RTR задается битом TXBnDLC.RTR и для стандартных фреймов
+  if (r[4] & MCP_IMAGE_DLC_RTR)
+  {
+    frame->flags |= MCP_FRAME_RTR;
+  }
+}
+
+void mcpSimTxDone(MCP_Sim* sim, uint8_t txb)
+{
+  sim->reg[REG_TXB0CTRL + txb * TXB_STEP] &= (uint8_t) ~TXBCTRL_TXREQ;
+  sim->reg[REG_CANINTF] |= (uint8_t) (INTF_TX0IF << txb);
+  sim->txFrames++;
+}
@@ -0,0 +1,98 @@
+#ifndef SIM_MCP2515_H
+#define SIM_MCP2515_H
+
+#include "driver_mcp2515.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MCP_SIM_REGISTERS 128U ///< Размер карты регистров MCP2515
+
+/// @brief Структура для описания программной модели MCP2515
+/// @details Модель интерпретирует команды SPI (RESET, READ, WRITE, BIT MODIFY,
+/// LOAD TX BUFFER, READ RX BUFFER, RTS, READ STATUS, RX STATUS) над картой из
+/// 128 регистров с семантикой передающих и приемных буферов, флагов
+/// прерываний, фильтров и режимов работы. Используется как транспорт
+/// MCP_Instance для тестирования и измерения производительности без
+/// аппаратуры. Пользователь не должен напрямую изменять поля структуры.
+struct MCP_Sim
+{
+  uint8_t reg[MCP_SIM_REGISTERS]; ///< Карта регистров
+
+  bool    selected; ///< Состояние сигнала CS
+  uint8_t phase;    ///< Номер байта в текущей команде SPI
+  uint8_t cmd;      ///< Текущая команда SPI
+  uint8_t addr;     ///< Текущий адрес
+  uint8_t mask;     ///< Маска команды BIT MODIFY
+  uint8_t rxRead;   ///< Флаги RXnIF, сбрасываемые по окончании READ RX BUFFER
+
+  uint32_t spiBytes;  ///< Количество байт, переданных по SPI
+  uint32_t csCycles;  ///< Количество выборов микросхемы
+  uint32_t txFrames;  ///< Количество переданных фреймов
+  uint32_t rxFrames;  ///< Количество принятых фреймов
+  uint32_t rxDropped; ///< Количество фреймов, потерянных из-за переполнения
+};
+typedef struct MCP_Sim MCP_Sim;
+
+/// @brief Инициализирует модель состоянием после сброса (режим конфигурации)
+/// @param [in] sim указатель на модель
+void mcpSimInit(MCP_Sim* sim);
+
+/// @brief Подключает модель к экземпляру драйвера в качестве транспорта
+/// @param [in] sim указатель на модель
+/// @param [in] ins указатель на экземпляр драйвера
+/// @details Задает ctx, chipSelectCtx и transactionCtx. Функции
+/// mcpSimTransfer и mcpSimTransactionv пользователь может задать сам.
+void mcpSimAttach(MCP_Sim* sim, MCP_Instance* ins);
+
+/// @brief Реализация chipSelectCtx для модели (ctx - указатель на MCP_Sim)
+void mcpSimChipSelect(void* ctx, bool select);
+
+/// @brief Реализация transactionCtx для модели (ctx - указатель на MCP_Sim)
+/// @details Если вызов выполнен без выбора микросхемы (режим
+/// MCP_FLAG_TRANSPORT_CS), модель сама выбирает микросхему на время вызова.
+int32_t mcpSimTransaction(void* ctx, uint8_t* data, uint8_t len);
+
+/// @brief Реализация transfer для модели (ctx - указатель на MCP_Sim)
+int32_t mcpSimTransfer(void* ctx, const uint8_t* tx, uint8_t* rx, uint8_t len);
+
+/// @brief Реализация transactionv для модели (ctx - указатель на MCP_Sim)
+/// @details Если вызов выполнен без выбора микросхемы (режим
+/// MCP_FLAG_TRANSPORT_CS), модель сама выбирает микросхему на время вызова.
+int32_t mcpSimTransactionv(void* ctx, const MCP_Segment* seg, uint8_t count);
+
+/// @brief Возвращает текущий режим работы модели (см. MCP_MODE_*)
+uint8_t mcpSimMode(const MCP_Sim* sim);
+
+/// @brief Проверяет состояние вывода INT (CANINTF & CANINTE)
+/// @return true, если вывод INT активен
+bool mcpSimInterrupt(const MCP_Sim* sim);
+
+/// @brief Принимает фрейм с шины с учетом фильтров, масок и режима BUKT
+/// @param [in] sim указатель на модель
+/// @param [in] frame принимаемый фрейм
+/// @return true, если фрейм прошел фильтры и записан в приемный буфер
+bool mcpSimReceive(MCP_Sim* sim, const MCP_Frame* frame);
+
+/// @brief Возвращает номер передающего буфера, ожидающего передачи, с
+/// наибольшим приоритетом (биты TXP, затем больший номер буфера)
+/// @return номер буфера (0..2) или -1, если передавать нечего
+int8_t mcpSimPendingTx(const MCP_Sim* sim);
+
+/// @brief Читает фрейм из передающего буфера модели
+/// @param [in] sim указатель на модель
+/// @param [in] txb номер передающего буфера (0..2)
+/// @param [out] frame сюда запишется фрейм
+void mcpSimTxFrame(const MCP_Sim* sim, uint8_t txb, MCP_Frame* frame);
+
+/// @brief Завершает передачу из передающего буфера: сбрасывает TXREQ и
+/// устанавливает TXnIF
+/// @param [in] sim указатель на модель
+/// @param [in] txb номер передающего буфера (0..2)
+void mcpSimTxDone(MCP_Sim* sim, uint8_t txb);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // SIM_MCP2515_H
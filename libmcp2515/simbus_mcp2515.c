@@ -0,0 +1,234 @@
+#if defined(__unix__) && !defined(_POSIX_C_SOURCE)
+#  define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "simbus_mcp2515.h"
+
+#if defined(__unix__)
+#  include <errno.h>
+#  include <time.h>
+#endif
+
+#define NS_PER_SECOND 1000000000ULL
+
+#define CRC15_POLY 0x4599U
+#define CRC15_MASK 0x7FFFU
+
+#define STUFF_RUN    5U  ///< Количество одинаковых бит, после которых вставляется бит-вставка
+#define FRAME_TAIL   13U ///< Разделитель CRC, ACK, разделитель ACK, EOF и межкадровый интервал
+#define NO_PREV_BIT  2U
+
+/// @brief Состояние генератора потока бит фрейма
+typedef struct
+{
+  uint32_t count; ///< Количество бит, включая биты-вставки
+  uint16_t crc;   ///< CRC-15
+  uint8_t  last;  ///< Значение предыдущего бита
+  uint8_t  run;   ///< Количество одинаковых бит подряд
+} BitStream;
+
+static void emitBit(BitStream* s, uint8_t bit)
+{
+  s->count++;
+  if (bit == s->last)
+  {
+    s->run++;
+  }
+  else
+  {
+    s->last = bit;
+    s->run  = 1;
+  }
+
+  if (s->run == STUFF_RUN)
+  {
+    s->count++;
+    s->last = (uint8_t) !bit;
+    s->run  = 1;
+  }
+}
+
+/// @brief Добавляет поле фрейма, участвующее в вычислении CRC
+static void putField(BitStream* s, uint32_t value, uint8_t width)
+{
+  while (width--)
+  {
+    uint8_t bit = (uint8_t) ((value >> width) & 1U);
+    uint8_t nxt = (uint8_t) (bit ^ ((s->crc >> 14) & 1U));
+
+    s->crc = (uint16_t) ((s->crc << 1) & CRC15_MASK);
+    if (nxt)
+    {
+      s->crc ^= CRC15_POLY;
+    }
+    emitBit(s, bit);
+  }
+}
+
+uint32_t mcpSimBusFrameBits(const MCP_Frame* frame)
+{
+  BitStream s   = {0, 0, NO_PREV_BIT, 0};
+  bool      rtr = (frame->flags & MCP_FRAME_RTR) != 0U;
+  uint8_t   dlc = (frame->dlc > 8U) ? 8U : frame->dlc;
+
+  putField(&s, 0, 1);  // SOF
+  if (frame->flags & MCP_FRAME_IDE)
+  {
+    putField(&s, (frame->id >> 18) & 0x7FFU, 11);
+    putField(&s, 3, 2);  // SRR, IDE
+    putField(&s, frame->id & 0x3FFFFU, 18);
+    putField(&s, rtr ? 1U : 0U, 1);
+    putField(&s, 0, 2);  // r1, r0
+  }
+  else
+  {
+    putField(&s, frame->id & 0x7FFU, 11);
+    putField(&s, rtr ? 1U : 0U, 1);
+    putField(&s, 0, 2);  // IDE, r0
+  }
+  putField(&s, dlc, 4);
+  if (!rtr)
+  {
+    for (uint8_t i = 0; i < dlc; i++)
+    {
+      putField(&s, frame->data[i], 8);
+    }
+  }
+
+  uint16_t crc = s.crc;
+  for (uint8_t i = 15; i > 0; i--)
+  {
+    emitBit(&s, (uint8_t) ((crc >> (i - 1U)) & 1U));
+  }
+  return s.count + FRAME_TAIL;
+}
+
+void mcpSimBusInit(MCP_SimBus* bus, uint32_t bitrate)
+{
+  for (uint8_t i = 0; i < MCP_SIMBUS_NODES; i++)
+  {
+    bus->nodes[i] = NULL;
+  }
+  bus->count   = 0;
+  bus->bitrate = bitrate;
+  bus->bits    = 0;
+  bus->frames  = 0;
+  bus->lost    = 0;
+  bus->pace    = NULL;
+  bus->paceCtx = NULL;
+  bus->epochNs = 0;
+}
+
+bool mcpSimBusAttach(MCP_SimBus* bus, MCP_Sim* sim)
+{
+  if (bus->count >= MCP_SIMBUS_NODES)
+  {
+    return false;
+  }
+  bus->nodes[bus->count++] = sim;
+  return true;
+}
+
+bool mcpSimBusStep(MCP_SimBus* bus)
+{
+  MCP_Frame frame;
+  MCP_Frame best;
+  uint32_t  bestKey  = 0;
+  int8_t    winner   = -1;
+  uint8_t   bestTxb  = 0;
+  uint8_t   contests = 0;
+
+  for (uint8_t i = 0; i < bus->count; i++)
+  {
+    MCP_Sim* sim = bus->nodes[i];
+    if (mcpSimMode(sim) != MCP_MODE_NORMAL)
+    {
+      continue;
+    }
+
+    int8_t txb = mcpSimPendingTx(sim);
+    if (txb < 0)
+    {
+      continue;
+    }
+
+    mcpSimTxFrame(sim, (uint8_t) txb, &frame);
+    uint32_t key = mcpArbitrationKey(&frame);
+    contests++;
+    if ((winner < 0) || (key < bestKey))
+    {
+      winner  = (int8_t) i;
+      bestKey = key;
+      bestTxb = (uint8_t) txb;
+      best    = frame;
+    }
+  }
+
+  if (winner < 0)
+  {
+    return false;
+  }
+
+  mcpSimTxDone(bus->nodes[winner], bestTxb);
+  for (uint8_t i = 0; i < bus->count; i++)
+  {
+    if (i != (uint8_t) winner)
+    {
+      mcpSimReceive(bus->nodes[i], &best);
+    }
+  }
+
+  bus->bits += mcpSimBusFrameBits(&best);
+  bus->frames++;
+  bus->lost += (uint32_t) (contests - 1U);
+
+  if (bus->pace)
+  {
+    bus->pace(bus->paceCtx, mcpSimBusTimeNs(bus));
+  }
+  return true;
+}
+
+uint32_t mcpSimBusRun(MCP_SimBus* bus, uint32_t limit)
+{
+  uint32_t frames = 0;
+  while ((frames < limit) && mcpSimBusStep(bus))
+  {
+    frames++;
+  }
+  return frames;
+}
+
+uint64_t mcpSimBusTimeNs(const MCP_SimBus* bus)
+{
+  // без переполнения при больших значениях bits
+  return (bus->bits / bus->bitrate) * NS_PER_SECOND + ((bus->bits % bus->bitrate) * NS_PER_SECOND) / bus->bitrate;
+}
+
+#if defined(__unix__)
+void mcpSimBusRealtime(void* ctx, uint64_t timeNs)
+{
+  MCP_SimBus*     bus = (MCP_SimBus*) ctx;
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t nowNs = (uint64_t) now.tv_sec * NS_PER_SECOND + (uint64_t) now.tv_nsec;
+  if (bus->epochNs == 0U)
+  {
+    bus->epochNs = nowNs - timeNs;
+  }
+
+  uint64_t deadline = bus->epochNs + timeNs;
+  if (deadline <= nowNs)
+  {
+    return;
+  }
+
+  struct timespec delay;
+  delay.tv_sec  = (time_t) ((deadline - nowNs) / NS_PER_SECOND);
+  delay.tv_nsec = (long) ((deadline - nowNs) % NS_PER_SECOND);
+  while ((nanosleep(&delay, &delay) != 0) && (errno == EINTR))
+  {
+  }
+}
+#endif
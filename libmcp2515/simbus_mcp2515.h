@@ -0,0 +1,89 @@
+#ifndef SIMBUS_MCP2515_H
+#define SIMBUS_MCP2515_H
+
+#include "sim_mcp2515.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MCP_SIMBUS_NODES
+#  define MCP_SIMBUS_NODES 8U ///< Наибольшее количество моделей на одной шине
+#endif
+
+/// @brief Функция синхронизации модельного времени шины с реальным
+/// @param [in] ctx пользовательский контекст (MCP_SimBus::paceCtx)
+/// @param [in] timeNs модельное время окончания очередного фрейма (нс)
+typedef void (*MCP_SimBusPace)(void* ctx, uint64_t timeNs);
+
+/// @brief Структура для описания виртуальной шины CAN
+/// @details Шина соединяет несколько моделей MCP_Sim. Каждый шаг шины
+/// выбирает среди запросов передачи всех узлов фрейм, выигрывающий
+/// арбитраж (наименьшее значение полей идентификатора, SRR, IDE и RTR в
+/// порядке их следования на шине), доставляет его остальным узлам и
+/// увеличивает модельное время на длительность фрейма с учетом битстаффинга,
+/// межкадрового интервала и скорости шины. Шина работает быстрее реального
+/// времени, если не задана функция pace. Ошибки шины и отсутствие
+/// подтверждения (ACK) не моделируются.
+struct MCP_SimBus
+{
+  MCP_Sim* nodes[MCP_SIMBUS_NODES]; ///< Подключенные модели
+  uint8_t  count;                   ///< Количество подключенных моделей
+  uint32_t bitrate;                 ///< Скорость шины (бит/с)
+
+  uint64_t bits;   ///< Количество переданных бит с момента инициализации (модельное время)
+  uint32_t frames; ///< Количество переданных фреймов
+  uint32_t lost;   ///< Количество проигранных арбитражей
+
+  MCP_SimBusPace pace;    ///< Синхронизация с реальным временем (NULL - не используется)
+  void*          paceCtx; ///< Контекст функции pace
+  uint64_t       epochNs; ///< Начало отсчета для mcpSimBusRealtime
+};
+typedef struct MCP_SimBus MCP_SimBus;
+
+/// @brief Инициализирует шину без подключенных узлов
+/// @param [in] bus указатель на шину
+/// @param [in] bitrate скорость шины (бит/с)
+void mcpSimBusInit(MCP_SimBus* bus, uint32_t bitrate);
+
+/// @brief Подключает модель к шине
+/// @param [in] bus указатель на шину
+/// @param [in] sim указатель на модель
+/// @return true, если модель подключена; false, если шина заполнена
+bool mcpSimBusAttach(MCP_SimBus* bus, MCP_Sim* sim);
+
+/// @brief Вычисляет длительность фрейма в битах
+/// @param [in] frame фрейм
+/// @return количество бит от SOF до конца межкадрового интервала, включая
+/// биты, вставленные при битстаффинге (с вычислением CRC-15)
+uint32_t mcpSimBusFrameBits(const MCP_Frame* frame);
+
+/// @brief Передает по шине один фрейм, выигравший арбитраж
+/// @param [in] bus указатель на шину
+/// @return true, если фрейм передан; false, если передавать нечего
+/// @details Передают только узлы в нормальном режиме. Фрейм принимают все
+/// остальные узлы в нормальном режиме и режиме только прослушивания.
+bool mcpSimBusStep(MCP_SimBus* bus);
+
+/// @brief Передает фреймы, пока есть запросы передачи
+/// @param [in] bus указатель на шину
+/// @param [in] limit наибольшее количество фреймов
+/// @return количество переданных фреймов
+uint32_t mcpSimBusRun(MCP_SimBus* bus, uint32_t limit);
+
+/// @brief Возвращает модельное время шины (нс)
+uint64_t mcpSimBusTimeNs(const MCP_SimBus* bus);
+
+#if defined(__unix__)
+/// @brief Функция pace, приостанавливающая поток до наступления модельного
+/// времени (POSIX, CLOCK_MONOTONIC)
+/// @param [in] ctx указатель на MCP_SimBus
+/// @param [in] timeNs модельное время окончания фрейма (нс)
+/// @details Начало отсчета фиксируется при первом вызове.
+void mcpSimBusRealtime(void* ctx, uint64_t timeNs);
+#endif
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // SIMBUS_MCP2515_H
@@ -0,0 +1,118 @@
+#include "spicost_mcp2515.h"
+
+#define NS_PER_SECOND 1000000000ULL
+#define BITS_PER_BYTE 8U
+
+/// @brief Учитывает обмен одним вызовом транспорта
+/// @param [in] tx передаваемые данные (байт команды, если это начало транзакции)
+/// @param [in] len количество байт
+static void account(MCP_SpiCost* cost, const uint8_t* tx, uint32_t len)
+{
+  // без выбора микросхемы драйвером (MCP_FLAG_TRANSPORT_CS) каждый вызов -
+  // отдельная транзакция
+  if (!cost->selected || !cost->counted)
+  {
+    cost->op      = (tx && len) ? mcpCommandType(tx[0]) : (uint8_t) MCP_COMMAND_OTHER;
+    cost->counted = cost->selected;
+    cost->ops[cost->op].frames++;
+  }
+  cost->ops[cost->op].bytes += len;
+}
+
+static void costChipSelect(void* ctx, bool select)
+{
+  MCP_SpiCost* cost = (MCP_SpiCost*) ctx;
+
+  cost->selected = select;
+  cost->counted  = false;
+  mcpTransportChipSelect(&cost->next, select);
+}
+
+static int32_t costTransaction(void* ctx, uint8_t* data, uint8_t len)
+{
+  MCP_SpiCost* cost = (MCP_SpiCost*) ctx;
+
+  account(cost, data, len);
+  return mcpTransportTransaction(&cost->next, data, len);
+}
+
+static int32_t costTransactionv(void* ctx, const MCP_Segment* seg, uint8_t count)
+{
+  MCP_SpiCost* cost = (MCP_SpiCost*) ctx;
+  uint32_t     len  = 0;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    len += seg[i].len;
+  }
+  account(cost, count ? seg[0].tx : NULL, len);
+  return cost->next.transactionv(cost->next.ctx, seg, count);
+}
+
+static int32_t costTransfer(void* ctx, const uint8_t* tx, uint8_t* rx, uint8_t len)
+{
+  MCP_SpiCost* cost = (MCP_SpiCost*) ctx;
+
+  account(cost, tx, len);
+  return cost->next.transfer(cost->next.ctx, tx, rx, len);
+}
+
+int32_t mcpSpiCostInit(MCP_SpiCost* cost, uint32_t sckHz, uint32_t csOverheadNs)
+{
+  cost->sckHz        = sckHz;
+  cost->csOverheadNs = csOverheadNs;
+  cost->next         = (MCP_Transport) {NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+  cost->selected     = false;
+  cost->counted      = false;
+  cost->op           = MCP_COMMAND_OTHER;
+  mcpSpiCostReset(cost);
+
+  return (sckHz == 0U) ? MCP_ERROR : MCP_OK;
+}
+
+void mcpSpiCostAttach(MCP_SpiCost* cost, MCP_Instance* ins)
+{
+  const MCP_Transport wrapper = {cost, costChipSelect, costTransaction, costTransactionv, costTransfer, NULL, NULL};
+  mcpTransportInterpose(ins, &wrapper, &cost->next);
+}
+
+void mcpSpiCostReset(MCP_SpiCost* cost)
+{
+  for (uint8_t i = 0; i < MCP_COMMAND_TYPES; i++)
+  {
+    cost->ops[i].frames = 0;
+    cost->ops[i].bytes  = 0;
+  }
+}
+
+uint64_t mcpSpiCostTimeNs(const MCP_SpiCost* cost, MCPCommandType op)
+{
+  uint64_t frames = 0;
+  uint64_t bits   = 0;
+
+  if (cost->sckHz == 0U)
+  {
+    return 0;
+  }
+  for (uint8_t i = 0; i < MCP_COMMAND_TYPES; i++)
+  {
+    if ((op == MCP_COMMAND_TYPES) || (op == (MCPCommandType) i))
+    {
+      frames += cost->ops[i].frames;
+      bits += (uint64_t) cost->ops[i].bytes * BITS_PER_BYTE;
+    }
+  }
+  return (bits * NS_PER_SECOND + cost->sckHz - 1U) / cost->sckHz + frames * cost->csOverheadNs;
+}
+
+uint32_t mcpSpiCostFramesPerSecond(const MCP_SpiCost* cost, uint32_t frames, uint8_t chips)
+{
+  uint64_t ns = mcpSpiCostTimeNs(cost, MCP_COMMAND_TYPES) * (chips ? chips : 1U);
+  if (ns == 0U)
+  {
+    return 0;
+  }
+
+  uint64_t rate = ((uint64_t) frames * NS_PER_SECOND) / ns;
+  return (rate > UINT32_MAX) ? UINT32_MAX : (uint32_t) rate;
+}
@@ -0,0 +1,78 @@
+#ifndef SPICOST_MCP2515_H
+#define SPICOST_MCP2515_H
+
+#include "interpose_mcp2515.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Счетчики одного типа операций
+struct MCP_SpiCostCounter
+{
+  uint32_t frames; ///< Количество выборов микросхемы (транзакций SPI)
+  uint32_t bytes;  ///< Количество переданных байт
+};
+typedef struct MCP_SpiCostCounter MCP_SpiCostCounter;
+
+/// @brief Структура для описания модели стоимости обмена по SPI
+/// @details Модель подключается к экземпляру драйвера вместо его транспорта
+/// (mcpSpiCostAttach), передает все вызовы исходному транспорту и учитывает
+/// для каждого типа операции количество транзакций и байт. Время занятости
+/// шины SPI вычисляется по частоте SCK и накладным расходам на каждый выбор
+/// микросхемы (установка и удержание CS, минимальное время высокого уровня).
+/// Пользователь не должен напрямую изменять поля структуры, кроме параметров модели.
+struct MCP_SpiCost
+{
+  uint32_t sckHz;        ///< Частота SCK (Гц)
+  uint32_t csOverheadNs; ///< Накладные расходы на один выбор микросхемы (нс)
+
+  MCP_SpiCostCounter ops[MCP_COMMAND_TYPES]; ///< Счетчики по типам команд (см. MCPCommandType)
+
+  MCP_Transport next; ///< Исходный транспорт экземпляра драйвера
+
+  bool    selected; ///< Микросхема выбрана
+  bool    counted;  ///< Текущая транзакция уже учтена
+  uint8_t op;       ///< Тип текущей команды (см. MCPCommandType)
+};
+typedef struct MCP_SpiCost MCP_SpiCost;
+
+/// @brief Инициализирует модель и обнуляет счетчики
+/// @param [in] cost указатель на модель
+/// @param [in] sckHz частота SCK (Гц)
+/// @param [in] csOverheadNs накладные расходы на один выбор микросхемы (нс)
+/// @return MCP_OK, если параметры корректны; иначе MCP_ERROR (sckHz равна 0)
+int32_t mcpSpiCostInit(MCP_SpiCost* cost, uint32_t sckHz, uint32_t csOverheadNs);
+
+/// @brief Подключает модель к экземпляру драйвера
+/// @param [in] cost указатель на модель
+/// @param [in] ins указатель на экземпляр драйвера с заданным транспортом
+/// @details Сохраняет функции транспорта и ctx экземпляра и заменяет их
+/// функциями модели (ctx экземпляра начинает указывать на модель).
+/// Необязательные функции transactionv и transfer подменяются, только если
+/// они были заданы.
+void mcpSpiCostAttach(MCP_SpiCost* cost, MCP_Instance* ins);
+
+/// @brief Обнуляет счетчики модели
+void mcpSpiCostReset(MCP_SpiCost* cost);
+
+/// @brief Возвращает время занятости шины SPI операциями одного типа (нс)
+/// @param [in] cost указатель на модель
+/// @param [in] op тип команды (MCP_COMMAND_TYPES - все команды)
+/// @return время в наносекундах; 0, если частота SCK равна 0
+uint64_t mcpSpiCostTimeNs(const MCP_SpiCost* cost, MCPCommandType op);
+
+/// @brief Вычисляет наибольшее количество фреймов в секунду, которое
+/// выдерживает шина SPI
+/// @param [in] cost указатель на модель, накопившую обмен за frames фреймов
+/// @param [in] frames количество фреймов, обработанных за время учета
+/// @param [in] chips количество микросхем с той же нагрузкой на одной шине SPI
+/// @return фреймов в секунду на одну микросхему; при chips = 1 - предел для
+/// микросхемы на отдельной шине, суммарный предел общей шины равен
+/// результату, умноженному на chips
+uint32_t mcpSpiCostFramesPerSecond(const MCP_SpiCost* cost, uint32_t frames, uint8_t chips);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // SPICOST_MCP2515_H
@@ -0,0 +1,345 @@
+#include "trace_mcp2515.h"
+#include "atomic_mcp2515.h"
+
+#define DATA_LEN    5U ///< Смещение длины в записи обмена
+#define DATA_RESULT 6U ///< Смещение результата в записи обмена
+
+static void put(MCP_Trace* trace, uint32_t pos, uint8_t value)
+{
+  trace->ring[pos & (trace->size - 1U)] = value;
+}
+
+/// @brief Копирует данные в кольцевой буфер
+/// @param [in] data данные (NULL - нули)
+/// @return позицию после скопированных данных
+static uint32_t putBytes(MCP_Trace* trace, uint32_t pos, const uint8_t* data, uint8_t len)
+{
+  for (uint8_t i = 0; i < len; i++)
+  {
+    put(trace, pos++, data ? data[i] : 0U);
+  }
+  return pos;
+}
+
+/// @brief Записывает тип и метку времени
+/// @return позицию после заголовка
+static uint32_t putHeader(MCP_Trace* trace, uint32_t pos, uint8_t type)
+{
+  uint32_t time = trace->clock ? trace->clock() : 0U;
+
+  put(trace, pos++, type);
+  for (uint8_t i = 0; i < 4U; i++)
+  {
+    put(trace, pos++, (uint8_t) (time >> (8U * i)));
+  }
+  return pos;
+}
+
+/// @brief Проверяет наличие места для записи
+/// @param [in] len размер записи (байт)
+/// @return true, если запись помещается; иначе увеличивает счетчик dropped
+static bool reserve(MCP_Trace* trace, uint32_t len)
+{
+  if ((trace->size - (trace->head - mcpLoadAcquire(&trace->tail))) < len)
+  {
+    trace->dropped++;
+    return false;
+  }
+  return true;
+}
+
+static void publish(MCP_Trace* trace, uint32_t len)
+{
+  mcpStoreRelease(&trace->head, trace->head + len);
+}
+
+static void traceChipSelect(void* ctx, bool select)
+{
+  MCP_Trace* trace = (MCP_Trace*) ctx;
+
+  if (reserve(trace, MCP_TRACE_EVENT_SIZE))
+  {
+    putHeader(trace, trace->head, select ? MCP_TRACE_SELECT : MCP_TRACE_DESELECT);
+    publish(trace, MCP_TRACE_EVENT_SIZE);
+  }
+  mcpTransportChipSelect(&trace->next, select);
+}
+
+/// @brief Начинает запись обмена: заголовок и MOSI
+/// @return позицию байт MISO
+static uint32_t beginData(MCP_Trace* trace, uint32_t pos, const uint8_t* tx, uint8_t len)
+{
+  pos = putHeader(trace, pos, MCP_TRACE_DATA);
+  put(trace, pos++, len);
+  put(trace, pos++, 0U);
+  return putBytes(trace, pos, tx, len);
+}
+
+/// @brief Завершает запись обмена: результат и MISO
+/// @param [in] start позиция начала записи
+static void endData(MCP_Trace* trace, uint32_t start, const uint8_t* rx, uint8_t len, int32_t res)
+{
+  put(trace, start + DATA_RESULT, (uint8_t) (int8_t) res);
+  putBytes(trace, start + MCP_TRACE_DATA_SIZE + len, rx, len);
+}
+
+static int32_t traceTransaction(void* ctx, uint8_t* data, uint8_t len)
+{
+  MCP_Trace* trace = (MCP_Trace*) ctx;
+  uint32_t   size  = MCP_TRACE_DATA_SIZE + 2U * len;
+  bool       keep  = reserve(trace, size);
+
+  // MOSI сохраняется до обмена: транспорт заменяет данные принятыми
+  if (keep)
+  {
+    beginData(trace, trace->head, data, len);
+  }
+  int32_t res = mcpTransportTransaction(&trace->next, data, len);
+  if (keep)
+  {
+    endData(trace, trace->head, data, len, res);
+    publish(trace, size);
+  }
+  return res;
+}
+
+static int32_t traceTransactionv(void* ctx, const MCP_Segment* seg, uint8_t count)
+{
+  MCP_Trace* trace = (MCP_Trace*) ctx;
+  uint32_t   size  = 0;
+
+  // каждый сегмент - отдельная запись обмена
+  for (uint8_t i = 0; i < count; i++)
+  {
+    size += MCP_TRACE_DATA_SIZE + 2U * seg[i].len;
+  }
+
+  bool     keep = reserve(trace, size);
+  uint32_t pos  = trace->head;
+  if (keep)
+  {
+    for (uint8_t i = 0; i < count; i++)
+    {
+      pos = beginData(trace, pos, seg[i].tx, seg[i].len) + seg[i].len;
+    }
+  }
+
+  int32_t res = trace->next.transactionv(trace->next.ctx, seg, count);
+  if (keep)
+  {
+    pos = trace->head;
+    for (uint8_t i = 0; i < count; i++)
+    {
+      endData(trace, pos, seg[i].rx, seg[i].len, res);
+      pos += MCP_TRACE_DATA_SIZE + 2U * seg[i].len;
+    }
+    publish(trace, size);
+  }
+  return res;
+}
+
+static int32_t traceTransfer(void* ctx, const uint8_t* tx, uint8_t* rx, uint8_t len)
+{
+  MCP_Trace* trace = (MCP_Trace*) ctx;
+  uint32_t   size  = MCP_TRACE_DATA_SIZE + 2U * len;
+  bool       keep  = reserve(trace, size);
+
+  if (keep)
+  {
+    beginData(trace, trace->head, tx, len);
+  }
+
+  int32_t res = trace->next.transfer(trace->next.ctx, tx, rx, len);
+  if (keep)
+  {
+    endData(trace, trace->head, rx, len, res);
+    publish(trace, size);
+  }
+  return res;
+}
+
+int32_t mcpTraceInit(MCP_Trace* trace, uint8_t* ring, uint32_t size)
+{
+  trace->ring    = ring;
+  trace->size    = size;
+  trace->head    = 0;
+  trace->tail    = 0;
+  trace->dropped = 0;
+  trace->clock   = NULL;
+  trace->next    = (MCP_Transport) {NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+
+  if (!ring || (size == 0U) || ((size & (size - 1U)) != 0U))
+  {
+    return MCP_ERROR;
+  }
+  return MCP_OK;
+}
+
+void mcpTraceAttach(MCP_Trace* trace, MCP_Instance* ins)
+{
+  const MCP_Transport wrapper = {trace, traceChipSelect, traceTransaction, traceTransactionv, traceTransfer, NULL, NULL};
+  mcpTransportInterpose(ins, &wrapper, &trace->next);
+}
+
+uint32_t mcpTraceRead(MCP_Trace* trace, uint8_t* data, uint32_t len)
+{
+  uint32_t tail      = trace->tail;
+  uint32_t available = mcpLoadAcquire(&trace->head) - tail;
+
+  if (len > available)
+  {
+    len = available;
+  }
+  for (uint32_t i = 0; i < len; i++)
+  {
+    data[i] = trace->ring[(tail + i) & (trace->size - 1U)];
+  }
+  mcpStoreRelease(&trace->tail, tail + len);
+  return len;
+}
+
+static uint32_t timestamp(const uint8_t* record)
+{
+  return (uint32_t) record[1] | ((uint32_t) record[2] << 8U) | ((uint32_t) record[3] << 16U)
+         | ((uint32_t) record[4] << 24U);
+}
+
+/// @brief Возвращает текущую запись обмена, пропуская исчерпанные
+/// @return указатель на запись; NULL, если следующая запись - не обмен или
+/// трасса закончилась (в том числе обрезана)
+static const uint8_t* dataRecord(MCP_TraceReplay* replay)
+{
+  while (replay->pos + MCP_TRACE_DATA_SIZE <= replay->size)
+  {
+    const uint8_t* record = &replay->data[replay->pos];
+    uint8_t        len    = record[DATA_LEN];
+
+    if ((record[0] != MCP_TRACE_DATA)
+        || (replay->pos + MCP_TRACE_DATA_SIZE + 2U * len > replay->size))
+    {
+      break;
+    }
+    if (replay->used < len)
+    {
+      return record;
+    }
+    replay->pos += MCP_TRACE_DATA_SIZE + 2U * len;
+    replay->used = 0;
+  }
+  return NULL;
+}
+
+/// @brief Воспроизводит обмен одним вызовом транспорта
+/// @param [in] tx передаваемые драйвером данные (NULL - нули)
+/// @param [out] rx сюда помещаются записанные данные MISO (NULL - не сохранять)
+static int32_t replayBytes(MCP_TraceReplay* replay, const uint8_t* tx, uint8_t* rx, uint8_t len)
+{
+  int32_t res      = MCP_OK;
+  bool    mismatch = false;
+
+  for (uint8_t i = 0; i < len; i++)
+  {
+    const uint8_t* record = dataRecord(replay);
+    if (!record)
+    {
+      replay->mismatches++;
+      return MCP_ERROR;
+    }
+
+    uint8_t size = record[DATA_LEN];
+    if ((tx ? tx[i] : 0U) != record[MCP_TRACE_DATA_SIZE + replay->used])
+    {
+      mismatch = true;
+    }
+    if (rx)
+    {
+      rx[i] = record[MCP_TRACE_DATA_SIZE + size + replay->used];
+    }
+    if ((int8_t) record[DATA_RESULT] != MCP_OK)
+    {
+      res = (int8_t) record[DATA_RESULT];
+    }
+    replay->timestamp = timestamp(record);
+    if (++replay->used == size)
+    {
+      replay->pos += MCP_TRACE_DATA_SIZE + 2U * size;
+      replay->used = 0;
+    }
+  }
+
+  if (mismatch)
+  {
+    replay->mismatches++;
+  }
+  return res;
+}
+
+static void replayChipSelect(void* ctx, bool select)
+{
+  MCP_TraceReplay* replay = (MCP_TraceReplay*) ctx;
+
+  // недочитанный драйвером обмен - расхождение с трассой
+  if (dataRecord(replay))
+  {
+    replay->mismatches++;
+    replay->pos += MCP_TRACE_DATA_SIZE + 2U * replay->data[replay->pos + DATA_LEN];
+    replay->used = 0;
+  }
+
+  uint8_t type = select ? MCP_TRACE_SELECT : MCP_TRACE_DESELECT;
+  if ((replay->pos + MCP_TRACE_EVENT_SIZE <= replay->size) && (replay->data[replay->pos] == type))
+  {
+    replay->timestamp = timestamp(&replay->data[replay->pos]);
+    replay->pos += MCP_TRACE_EVENT_SIZE;
+  }
+  else
+  {
+    replay->mismatches++;
+  }
+}
+
+static int32_t replayTransaction(void* ctx, uint8_t* data, uint8_t len)
+{
+  return replayBytes((MCP_TraceReplay*) ctx, data, data, len);
+}
+
+static int32_t replayTransactionv(void* ctx, const MCP_Segment* seg, uint8_t count)
+{
+  int32_t res = MCP_OK;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    int32_t part = replayBytes((MCP_TraceReplay*) ctx, seg[i].tx, seg[i].rx, seg[i].len);
+    if (part != MCP_OK)
+    {
+      res = part;
+    }
+  }
+  return res;
+}
+
+static int32_t replayTransfer(void* ctx, const uint8_t* tx, uint8_t* rx, uint8_t len)
+{
+  return replayBytes((MCP_TraceReplay*) ctx, tx, rx, len);
+}
+
+void mcpTraceReplayInit(MCP_TraceReplay* replay, const uint8_t* data, uint32_t size)
+{
+  replay->data       = data;
+  replay->size       = size;
+  replay->pos        = 0;
+  replay->used       = 0;
+  replay->timestamp  = 0;
+  replay->mismatches = 0;
+}
+
+void mcpTraceReplayAttach(MCP_TraceReplay* replay, MCP_Instance* ins)
+{
+  const MCP_Transport wrapper = {replay, replayChipSelect, replayTransaction, replayTransactionv, replayTransfer, NULL, NULL};
+  mcpTransportInterpose(ins, &wrapper, NULL);
+}
+
+bool mcpTraceReplayDone(const MCP_TraceReplay* replay)
+{
+  return replay->pos >= replay->size;
+}
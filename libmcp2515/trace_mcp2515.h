@@ -0,0 +1,111 @@
+#ifndef TRACE_MCP2515_H
+#define TRACE_MCP2515_H
+
+#include "interpose_mcp2515.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MCP_TRACE_SELECT   0x01U ///< Запись: выбор микросхемы (CS - низкий уровень)
+#define MCP_TRACE_DESELECT 0x02U ///< Запись: снятие выбора микросхемы
+#define MCP_TRACE_DATA     0x03U ///< Запись: обмен данными
+
+#define MCP_TRACE_EVENT_SIZE 5U ///< Размер записи выбора: тип, метка времени (4 байта)
+#define MCP_TRACE_DATA_SIZE  7U ///< Заголовок записи обмена: тип, метка времени, длина, результат
+
+/// @brief Структура для описания записи трассы обмена по SPI
+/// @details Подключается к экземпляру драйвера вместо его транспорта
+/// (mcpTraceAttach) и передает все вызовы исходному транспорту, сохраняя в
+/// кольцевой буфер компактные записи (метка времени - little-endian):
+/// @b
+/// MCP_TRACE_SELECT / MCP_TRACE_DESELECT: тип (1), метка времени (4);
+/// @b
+/// MCP_TRACE_DATA: тип (1), метка времени (4), длина n (1), результат
+/// транспорта (int8), n байт MOSI, n байт MISO.
+/// @b
+/// Кольцевой буфер без блокировок рассчитан на одного писателя (поток
+/// драйвера) и одного читателя (mcpTraceRead). Если места в буфере нет,
+/// запись отбрасывается и увеличивается счетчик dropped: запись трассы никогда
+/// не задерживает обмен.
+struct MCP_Trace
+{
+  uint8_t* ring;    ///< Кольцевой буфер
+  uint32_t size;    ///< Размер буфера (степень двойки)
+  uint32_t head;    ///< Позиция записи (изменяется только писателем)
+  uint32_t tail;    ///< Позиция чтения (изменяется только читателем)
+  uint32_t dropped; ///< Количество отброшенных записей
+
+  /// @brief Возвращает метку времени (например, микросекунды или такты)
+  /// @details Необязательная функция (NULL - метки времени равны нулю)
+  uint32_t (*clock)(void);
+
+  MCP_Transport next; ///< Исходный транспорт экземпляра драйвера
+};
+typedef struct MCP_Trace MCP_Trace;
+
+/// @brief Инициализирует запись трассы
+/// @param [in] trace указатель на запись трассы
+/// @param [in] ring кольцевой буфер
+/// @param [in] size размер буфера (степень двойки)
+/// @return MCP_OK, если параметры корректны; иначе MCP_ERROR
+int32_t mcpTraceInit(MCP_Trace* trace, uint8_t* ring, uint32_t size);
+
+/// @brief Подключает запись трассы к экземпляру драйвера
+/// @param [in] trace указатель на запись трассы
+/// @param [in] ins указатель на экземпляр драйвера с заданным транспортом
+/// @details Сохраняет функции транспорта и ctx экземпляра и заменяет их
+/// функциями записи. Необязательные функции transactionv и transfer
+/// подменяются, только если они были заданы.
+void mcpTraceAttach(MCP_Trace* trace, MCP_Instance* ins);
+
+/// @brief Забирает накопленные данные трассы из кольцевого буфера
+/// @param [in] trace указатель на запись трассы
+/// @param [out] data сюда запишутся данные трассы
+/// @param [in] len наибольшее количество байт
+/// @return количество прочитанных байт
+/// @details Может вызываться из другого потока (единственный читатель).
+/// Записи могут быть разделены между вызовами: данные образуют поток байт.
+uint32_t mcpTraceRead(MCP_Trace* trace, uint8_t* data, uint32_t len);
+
+/// @brief Структура для описания воспроизведения трассы
+/// @details Подключается к экземпляру драйвера как транспорт
+/// (mcpTraceReplayAttach) и возвращает драйверу записанные байты MISO. Байты
+/// обмена внутри одного выбора микросхемы воспроизводятся как поток, поэтому
+/// разбиение на вызовы транспорта может отличаться от записанного. Байты MOSI
+/// драйвера сравниваются с записанными: расхождения учитываются в mismatches.
+/// При чтении без векторного обмена драйвер передает прежнее содержимое
+/// buffer, поэтому для сравнения MOSI набор функций транспорта должен
+/// совпадать с записанным.
+struct MCP_TraceReplay
+{
+  const uint8_t* data; ///< Трасса
+  uint32_t       size; ///< Размер трассы (байт)
+  uint32_t       pos;  ///< Позиция текущей записи
+  uint8_t        used; ///< Количество байт текущей записи обмена, уже выданных драйверу
+
+  uint32_t timestamp;  ///< Метка времени последней воспроизведенной записи
+  uint32_t mismatches; ///< Количество расхождений с трассой
+};
+typedef struct MCP_TraceReplay MCP_TraceReplay;
+
+/// @brief Инициализирует воспроизведение трассы
+/// @param [in] replay указатель на воспроизведение
+/// @param [in] data трасса (данные, полученные mcpTraceRead)
+/// @param [in] size размер трассы (байт)
+void mcpTraceReplayInit(MCP_TraceReplay* replay, const uint8_t* data, uint32_t size);
+
+/// @brief Подключает воспроизведение к экземпляру драйвера в качестве транспорта
+/// @param [in] replay указатель на воспроизведение
+/// @param [in] ins указатель на экземпляр драйвера
+/// @details Задает ctx, chipSelectCtx и transactionCtx; transactionv и
+/// transfer подменяются, только если они были заданы.
+void mcpTraceReplayAttach(MCP_TraceReplay* replay, MCP_Instance* ins);
+
+/// @brief Проверяет, воспроизведена ли трасса полностью
+bool mcpTraceReplayDone(const MCP_TraceReplay* replay);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // TRACE_MCP2515_H
@@ -0,0 +1,508 @@
+#include "../libmcp2515/driver_mcp2515.h"
+#include "../libmcp2515/driver_mcp2515.hpp"
+#include "../libmcp2515/sim_mcp2515.h"
+#include "../libmcp2515/simbus_mcp2515.h"
+#include "../libmcp2515/spicost_mcp2515.h"
+#include "../libmcp2515/service_mcp2515.h"
+#include "string.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#if defined(__x86_64__)
+#  include <x86intrin.h>
+#endif
+#if defined(__linux__)
+#  include <linux/perf_event.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+// Микротесты производительности драйвера. Результат выводится в stdout в
+// формате JSON: время, такты и инструкции на операцию, количество вызовов
+// функций транспорта и количество байт, переданных по SPI, на операцию.
+// Необязательный аргумент командной строки - количество итераций.
+
+// Образ приемных буферов: расширенный фрейм 0x1DA5678 с 8 байтами данных
+static const uint8_t FrameImage[32] = {0x00, 0x0E, 0xCA, 0x56, 0x78, 0x08, 1, 2, 3, 4, 5, 6, 7, 8, 0x00, 0x00,
+                                       0x00, 0x0E, 0xCA, 0x56, 0x78, 0x08, 1, 2, 3, 4, 5, 6, 7, 8, 0x00, 0x00};
+
+static volatile uint32_t Sink;
+
+// Счетчики вызовов функций транспорта и байт, переданных по SPI
+static uint64_t Callbacks;
+static uint64_t SpiBytes;
+
+static void chipSelect(bool select)
+{
+  (void) select;
+  Callbacks++;
+}
+
+static int32_t transaction(uint8_t* data, uint8_t len)
+{
+  memcpy(data, &FrameImage[0], len);
+  Callbacks++;
+  SpiBytes += len;
+  return MCP_OK;
+}
+
+static int32_t transactionv(void* ctx, const MCP_Segment* seg, uint8_t count)
+{
+  (void) ctx;
+  uint32_t sum = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (seg[i].tx)
+    {
+      sum += seg[i].tx[0] + seg[i].tx[seg[i].len - 1];
+    }
+    if (seg[i].rx)
+    {
+      memcpy(seg[i].rx, &FrameImage[0], seg[i].len);
+    }
+    SpiBytes += seg[i].len;
+  }
+  Sink = Sink + sum;
+  Callbacks++;
+  return MCP_OK;
+}
+
+static void countSelect(void* ctx, bool select)
+{
+  (void) ctx;
+  (void) select;
+  Callbacks++;
+}
+
+static int32_t countTransaction(void* ctx, uint8_t* data, uint8_t len)
+{
+  (void) ctx;
+  data[0] = 0;
+  Callbacks++;
+  SpiBytes += len;
+  return MCP_OK;
+}
+
+// Транспорт модели MCP2515 с подсчетом вызовов
+static void simSelect(void* ctx, bool select)
+{
+  Callbacks++;
+  mcpSimChipSelect(ctx, select);
+}
+
+static int32_t simTransaction(void* ctx, uint8_t* data, uint8_t len)
+{
+  Callbacks++;
+  SpiBytes += len;
+  return mcpSimTransaction(ctx, data, len);
+}
+
+static void simAttach(MCP_Sim* sim, MCP_Instance* ins)
+{
+  mcpSimInit(sim);
+  ins->ctx            = sim;
+  ins->chipSelectCtx  = simSelect;
+  ins->transactionCtx = simTransaction;
+}
+
+/// @brief Типичное ручное декодирование фрейма на стороне пользователя
+static int32_t handDecode(MCP_Instance* ins, MCP_Frame* frame)
+{
+  uint8_t* data;
+  uint8_t  len;
+
+  int32_t res = mcpReadRxBuffer(ins, MCP_READRXBUFFER_RXB0SIDH, &data, &len);
+  if (res != MCP_OK)
+  {
+    return res;
+  }
+
+  uint8_t copy[13];
+  memcpy(&copy[0], data, len);
+
+  uint32_t sid = ((uint32_t) copy[0] << 3) | ((uint32_t) copy[1] >> 5);
+  if (copy[1] & 0x08U)
+  {
+    frame->id    = (sid << 18) | ((uint32_t) (copy[1] & 0x03U) << 16) | ((uint32_t) copy[2] << 8) | copy[3];
+    frame->flags = (copy[4] & 0x40U) ? (uint8_t) (MCP_FRAME_IDE | MCP_FRAME_RTR) : (uint8_t) MCP_FRAME_IDE;
+  }
+  else
+  {
+    frame->id    = sid;
+    frame->flags = (copy[1] & 0x10U) ? (uint8_t) MCP_FRAME_RTR : (uint8_t) 0;
+  }
+  frame->dlc = (uint8_t) (copy[4] & 0x0FU);
+  if (frame->dlc > 8U)
+  {
+    frame->dlc = 8U;
+  }
+  memcpy(&frame->data[0], &copy[5], frame->dlc);
+  return res;
+}
+
+/// @brief Счетчик выполненных инструкций (perf_event), если он доступен
+class InstructionCounter
+{
+public:
+  InstructionCounter()
+  {
+#if defined(__linux__)
+    perf_event_attr attr = {};
+    attr.type            = PERF_TYPE_HARDWARE;
+    attr.size            = sizeof(attr);
+    attr.config          = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled        = 1;
+    attr.exclude_kernel  = 1;
+    attr.exclude_hv      = 1;
+    fd_                  = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+  }
+  ~InstructionCounter()
+  {
+#if defined(__linux__)
+    if (fd_ >= 0)
+    {
+      close(fd_);
+    }
+#endif
+  }
+  InstructionCounter(const InstructionCounter&)            = delete;
+  InstructionCounter& operator=(const InstructionCounter&) = delete;
+
+  void start()
+  {
+#if defined(__linux__)
+    if (fd_ >= 0)
+    {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  /// @return количество инструкций с момента start() или -1, если счетчик недоступен
+  double stop()
+  {
+#if defined(__linux__)
+    uint64_t count = 0;
+    if ((fd_ >= 0) && (ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0) == 0) && (read(fd_, &count, sizeof(count)) == sizeof(count)))
+    {
+      return (double) count;
+    }
+#endif
+    return -1.0;
+  }
+
+private:
+  int fd_ = -1;
+};
+
+static uint64_t cycles()
+{
+#if defined(__x86_64__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+struct Result
+{
+  const char* name;
+  double      ns;
+  double      cycles;
+  double      instructions;
+  double      callbacks;
+  double      spiBytes;
+};
+
+static std::vector<Result> Results;
+
+template <typename F>
+static Result measure(const char* name, uint32_t iterations, F&& op)
+{
+  static InstructionCounter counter;
+
+  Callbacks      = 0;
+  SpiBytes       = 0;
+  auto     start = std::chrono::steady_clock::now();
+  uint64_t c0    = cycles();
+  counter.start();
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    op();
+  }
+  double   instr = counter.stop();
+  uint64_t c1    = cycles();
+  auto     stop  = std::chrono::steady_clock::now();
+
+  Result r;
+  r.name         = name;
+  r.ns           = std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+  r.cycles       = (double) (c1 - c0) / iterations;
+  r.instructions = (instr < 0) ? -1.0 : instr / iterations;
+  r.callbacks    = (double) Callbacks / iterations;
+  r.spiBytes     = (double) SpiBytes / iterations;
+  Results.push_back(r);
+  return r;
+}
+
+/// @brief Транспорт шаблонного драйвера, выполняющий ту же работу, что и
+/// функции транспорта драйвера на C
+struct InlineTransport
+{
+  void select(bool select)
+  {
+    (void) select;
+    Callbacks++;
+  }
+  int32_t transfer(uint8_t* data, uint8_t len)
+  {
+    memcpy(data, &FrameImage[0], len);
+    Callbacks++;
+    SpiBytes += len;
+    return MCP_OK;
+  }
+};
+
+/// @brief Стоимость полного цикла фрейма по SPI (загрузка, RTS, опрос
+/// статуса, чтение, сброс флага) при SCK 10 МГц и 100 нс на выбор микросхемы
+static MCP_SpiCost Cost;
+
+static void frameCost()
+{
+  MCP_Sim      sim;
+  MCP_Instance ins = {};
+  MCP_Frame    frame;
+  uint8_t      status;
+
+  mcpSimInit(&sim);
+  mcpSimAttach(&sim, &ins);
+  mcpBitModify(&ins, 0x60, 0x60, 0x60);
+  mcpBitModify(&ins, 0x0F, 0xE0, 0x40);
+  mcpSpiCostInit(&Cost, 10000000U, 100U);
+  mcpSpiCostAttach(&Cost, &ins);
+
+  memset(&frame, 0, sizeof(frame));
+  frame.id  = 0x123;
+  frame.dlc = 8;
+  mcpLoadTxFrame(&ins, 0, &frame, nullptr);
+  mcpRTS(&ins, MCP_RTSCMD_BUFFER0);
+  mcpReadStatusInto(&ins, &status, nullptr);
+  mcpReceiveFrame(&ins, 0, &frame);
+  mcpBitModify(&ins, MCP_REG_CANINTF, 0x04, 0x00);
+}
+
+static void printCost()
+{
+  static const char* const names[MCP_COMMAND_TYPES] = {
+    "reset", "read", "write", "bit_modify", "load_tx", "read_rx", "rts", "read_status", "rx_status", "other"};
+
+  printf("  \"spi_cost\": {\"sck_hz\": %u, \"cs_overhead_ns\": %u, \"ops\": {", Cost.sckHz, Cost.csOverheadNs);
+  bool first = true;
+  for (uint8_t i = 0; i < MCP_COMMAND_TYPES; i++)
+  {
+    if (Cost.ops[i].frames)
+    {
+      printf("%s\"%s\": {\"frames\": %u, \"bytes\": %u, \"ns\": %llu}",
+             first ? "" : ", ",
+             names[i],
+             Cost.ops[i].frames,
+             Cost.ops[i].bytes,
+             (unsigned long long) mcpSpiCostTimeNs(&Cost, (MCPCommandType) i));
+      first = false;
+    }
+  }
+  printf("}, \"ns_per_frame\": %llu, \"frames_per_second_chip\": %u, \"frames_per_second_4_chips_shared\": %u},\n",
+         (unsigned long long) mcpSpiCostTimeNs(&Cost, MCP_COMMAND_TYPES),
+         mcpSpiCostFramesPerSecond(&Cost, 1, 1),
+         mcpSpiCostFramesPerSecond(&Cost, 1, 4));
+}
+
+static void printJson(uint32_t iterations, double busNs, double busFactor)
+{
+  printf("{\n  \"iterations\": %u,\n  \"buffer_size\": %u,\n  \"results\": [\n", iterations, (unsigned) MCP_BUFFER_SIZE);
+  for (size_t i = 0; i < Results.size(); i++)
+  {
+    const Result& r = Results[i];
+    printf("    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"cycles_per_op\": %.3f, ", r.name, r.ns, r.cycles);
+    if (r.instructions < 0)
+    {
+      printf("\"instructions_per_op\": null, ");
+    }
+    else
+    {
+      printf("\"instructions_per_op\": %.3f, ", r.instructions);
+    }
+    printf("\"callbacks_per_op\": %.3f, \"spi_bytes_per_op\": %.3f}%s\n",
+           r.callbacks,
+           r.spiBytes,
+           (i + 1 < Results.size()) ? "," : "");
+  }
+  printf("  ],\n");
+  printCost();
+  printf("  \"bus\": {\"bitrate\": 1000000, \"ns_per_frame\": %.3f, \"realtime_factor\": %.3f}\n}\n",
+         busNs,
+         busFactor);
+}
+
+int main(int argc, char** argv)
+{
+  const uint32_t iterations = (argc > 1) ? (uint32_t) strtoul(argv[1], nullptr, 0) : 10000000U;
+  if (iterations == 0)
+  {
+    fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+    return 1;
+  }
+
+  MCP_Instance ins = {};
+  MCP_Frame    frame;
+  MCP_Frame    frames[2];
+  MCP_Filters  filters;
+  uint8_t      regs[16];
+  uint8_t*     data;
+  uint8_t      len;
+  uint8_t      status;
+
+  ins.chipSelect  = chipSelect;
+  ins.transaction = transaction;
+  memset(&filters, 0, sizeof(filters));
+  memset(&regs[0], 0x5A, sizeof(regs));
+
+  // примитивы драйвера
+  measure("mcpRead", iterations, [&]() {
+    mcpRead(&ins, 0x28, &data, 3);
+    Sink = Sink + data[2];
+  });
+  measure("mcpReadInto", iterations, [&]() {
+    mcpReadInto(&ins, 0x28, &regs[0], 3);
+    Sink = Sink + regs[2];
+  });
+  measure("mcpWrite", iterations, [&]() { mcpWrite(&ins, 0x28, &regs[0], 3); });
+  measure("mcpReadRxBuffer", iterations, [&]() {
+    mcpReadRxBuffer(&ins, MCP_READRXBUFFER_RXB0SIDH, &data, &len);
+    Sink = Sink + data[len - 1];
+  });
+  measure("mcpReadRxBufferInto", iterations, [&]() {
+    mcpReadRxBufferInto(&ins, MCP_READRXBUFFER_RXB0D0, &regs[0], &len);
+    Sink = Sink + regs[len - 1];
+  });
+  measure("mcpLoadTxBuffer", iterations, [&]() { mcpLoadTxBuffer(&ins, MCP_LOADTXBUFFER_TXB0SIDH, &regs[0]); });
+  measure("mcpBitModify", iterations, [&]() { mcpBitModify(&ins, 0x2C, 0x01, 0x00); });
+  measure("mcpRTS", iterations, [&]() { mcpRTS(&ins, MCP_RTSCMD_BUFFER0); });
+  measure("mcpReadStatus", iterations, [&]() { Sink = Sink + (uint32_t) mcpReadStatus(&ins); });
+  measure("mcpRxStatus", iterations, [&]() { Sink = Sink + (uint32_t) mcpRxStatus(&ins); });
+  measure("mcpReadStatusInto", iterations, [&]() {
+    mcpReadStatusInto(&ins, &status, nullptr);
+    Sink = Sink + status;
+  });
+  measure("mcpRxStatusInto", iterations, [&]() {
+    mcpRxStatusInto(&ins, &status, nullptr);
+    Sink = Sink + status;
+  });
+
+  // операции над фреймами
+  measure("mcpReceiveFrame", iterations, [&]() {
+    mcpReceiveFrame(&ins, 0, &frame);
+    Sink = Sink + frame.id + frame.data[7];
+  });
+  ins.flags = MCP_FLAG_RX_TWOPHASE;
+  measure("mcpReceiveFrame 2-phase", iterations, [&]() {
+    mcpReceiveFrame(&ins, 0, &frame);
+    Sink = Sink + frame.id + frame.data[7];
+  });
+  ins.flags = 0;
+  measure("mcpReceiveBothFrames", iterations, [&]() {
+    mcpReceiveBothFrames(&ins, &frames[0]);
+    Sink = Sink + frames[0].id + frames[1].id;
+  });
+  measure("hand decoding", iterations, [&]() {
+    handDecode(&ins, &frame);
+    Sink = Sink + frame.id + frame.data[7];
+  });
+  measure("mcpWriteFilters", iterations, [&]() { mcpWriteFilters(&ins, &filters); });
+
+  frame.id    = 0x123;
+  frame.flags = 0;
+  frame.dlc   = 8;
+  measure("mcpLoadTxFrame", iterations, [&]() { mcpLoadTxFrame(&ins, 0, &frame, nullptr); });
+
+  // итерация цикла обслуживания: статус 0x0E - прием из RXB1 и сброс TX0IF
+  MCP_Service svc;
+  mcpServiceInit(&svc, &ins);
+  measure("mcpService", iterations, [&]() {
+    mcpService(&svc);
+    Sink = Sink + svc.rxFrames;
+  });
+
+  // векторный транспорт: без копирования через ins->buffer
+  ins.transactionv = transactionv;
+  measure("mcpLoadTxFrame vectored", iterations, [&]() { mcpLoadTxFrame(&ins, 0, &frame, nullptr); });
+  measure("mcpWriteFilters vectored", iterations, [&]() { mcpWriteFilters(&ins, &filters); });
+  measure("mcpReadInto vectored", iterations, [&]() {
+    mcpReadInto(&ins, 0x28, &regs[0], 3);
+    Sink = Sink + regs[2];
+  });
+  ins.transactionv = nullptr;
+
+  // управление CS драйвером и транспортом
+  MCP_Instance cs   = {};
+  cs.chipSelectCtx  = countSelect;
+  cs.transactionCtx = countTransaction;
+  measure("mcpBitModify driver CS", iterations, [&]() { mcpBitModify(&cs, 0x2C, 0x01, 0x00); });
+  cs.flags = MCP_FLAG_TRANSPORT_CS;
+  measure("mcpBitModify transport CS", iterations, [&]() { mcpBitModify(&cs, 0x2C, 0x01, 0x00); });
+
+  // шаблонный драйвер (вызовы транспорта разрешаются при компиляции)
+  mcp2515::Device<InlineTransport> dev;
+  frame.dlc = 8;
+  measure("C++ bitModify", iterations, [&]() { dev.bitModify(0x2C, 0x01, 0x00); });
+  measure("C++ loadTxFrame", iterations, [&]() { dev.loadTxFrame(0, frame); });
+  measure("C++ receiveFrame", iterations, [&]() {
+    dev.receiveFrame(0, frame);
+    Sink = Sink + frame.id;
+  });
+
+  // полный цикл фрейма через модель MCP2515 в режиме замкнутой петли
+  const uint32_t loops = (iterations >= 10U) ? (iterations / 10U) : 1U;
+  MCP_Sim        sim;
+  MCP_Instance   loop = {};
+  simAttach(&sim, &loop);
+  mcpBitModify(&loop, 0x60, 0x60, 0x60);
+  mcpBitModify(&loop, 0x0F, 0xE0, 0x40);
+  measure("loopback tx+rx frame", loops, [&]() {
+    mcpLoadTxFrame(&loop, 0, &frame, nullptr);
+    mcpRTS(&loop, MCP_RTSCMD_BUFFER0);
+    mcpReceiveFrame(&loop, 0, &frame);
+  });
+
+  // шлюз на полностью загруженной шине 1 Мбит/с: узел 0 передает без пауз,
+  // узел 1 принимает фреймы через драйвер
+  MCP_Sim      node[2];
+  MCP_Instance nodeIns[2] = {};
+  MCP_SimBus   bus;
+  mcpSimBusInit(&bus, 1000000U);
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    simAttach(&node[i], &nodeIns[i]);
+    mcpBitModify(&nodeIns[i], 0x60, 0x60, 0x60);
+    mcpBitModify(&nodeIns[i], 0x0F, 0xE0, 0x00);
+    mcpSimBusAttach(&bus, &node[i]);
+  }
+  frame.flags = 0;
+  Result r    = measure("bus 1 Mbit/s gateway frame", loops, [&]() {
+    frame.id = (frame.id + 1U) & 0x7FFU;
+    mcpLoadTxFrame(&nodeIns[0], 0, &frame, nullptr);
+    mcpRTS(&nodeIns[0], MCP_RTSCMD_BUFFER0);
+    mcpSimBusStep(&bus);
+    mcpReceiveFrame(&nodeIns[1], 0, &frame);
+  });
+  double busNs = (double) mcpSimBusTimeNs(&bus) / loops;
+
+  frameCost();
+
+  printJson(iterations, busNs, busNs / r.ns);
+  return 0;
+}
@@ -0,0 +1,111 @@
+#include "catch/catch.hpp"
+#include "../libmcp2515/rxring_mcp2515.h"
+#include "string.h"
+#include <thread>
+
+static MCP_Frame makeFrame(uint32_t n)
+{
+  MCP_Frame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.id  = n & 0x1FFFFFFFU;
+  frame.dlc = 8;
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    frame.data[i] = (uint8_t) (n >> (i & 3U) * 8U);
+  }
+  return frame;
+}
+
+static bool checkFrame(const MCP_Frame& frame, uint32_t n)
+{
+  MCP_Frame expected = makeFrame(n);
+  return (frame.id == expected.id) && (0 == memcmp(frame.data, expected.data, 8));
+}
+
+TEST_CASE("Receive ring")
+{
+  static MCP_RxRing ring;
+  MCP_Frame         frames[MCP_RXRING_SIZE + 1];
+  mcpRxRingInit(&ring);
+
+  // пустая очередь
+  REQUIRE(mcpRxRingCount(&ring) == 0);
+  REQUIRE(mcpRxRingPop(&ring, frames, 4) == 0);
+
+  // заполнение до предела
+  for (uint32_t i = 0; i < MCP_RXRING_SIZE; i++)
+  {
+    MCP_Frame frame = makeFrame(i);
+    REQUIRE(MCP_OK == mcpRxRingPush(&ring, &frame));
+  }
+  REQUIRE(mcpRxRingCount(&ring) == MCP_RXRING_SIZE);
+  REQUIRE(ring.peak == MCP_RXRING_SIZE);
+
+  // а если очередь заполнена?
+  MCP_Frame extra = makeFrame(1000);
+  REQUIRE(MCP_ERROR_BUFFER == mcpRxRingPush(&ring, &extra));
+  mcpRxRingReceive(&ring, &extra);
+  REQUIRE(ring.overflows == 2);
+
+  // чтение пачками
+  REQUIRE(mcpRxRingPop(&ring, frames, 3) == 3);
+  REQUIRE(checkFrame(frames[0], 0));
+  REQUIRE(checkFrame(frames[2], 2));
+  REQUIRE(mcpRxRingPop(&ring, frames, MCP_RXRING_SIZE + 1) == MCP_RXRING_SIZE - 3);
+  REQUIRE(checkFrame(frames[0], 3));
+  REQUIRE(checkFrame(frames[MCP_RXRING_SIZE - 4], MCP_RXRING_SIZE - 1));
+  REQUIRE(mcpRxRingCount(&ring) == 0);
+
+  // переход через конец буфера
+  for (uint32_t i = 0; i < 5; i++)
+  {
+    MCP_Frame frame = makeFrame(100 + i);
+    REQUIRE(MCP_OK == mcpRxRingPush(&ring, &frame));
+  }
+  REQUIRE(mcpRxRingPop(&ring, frames, 5) == 5);
+  REQUIRE(checkFrame(frames[4], 104));
+  REQUIRE(ring.overflows == 2);
+}
+
+TEST_CASE("Receive ring stress")
+{
+  static MCP_RxRing ring;
+  const uint32_t    total    = 200000;
+  uint32_t          received = 0;
+  uint32_t          errors   = 0;
+  mcpRxRingInit(&ring);
+
+  // писатель: при заполненной очереди повторяет попытку
+  std::thread producer([&]() {
+    for (uint32_t n = 0; n < total; n++)
+    {
+      MCP_Frame frame = makeFrame(n);
+      while (mcpRxRingPush(&ring, &frame) != MCP_OK)
+      {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  // читатель: пачки разного размера
+  MCP_Frame frames[7];
+  uint32_t  batch = 1;
+  while (received < total)
+  {
+    uint32_t count = mcpRxRingPop(&ring, frames, batch);
+    for (uint32_t i = 0; i < count; i++)
+    {
+      errors += checkFrame(frames[i], received++) ? 0U : 1U;
+    }
+    if (count == 0)
+    {
+      std::this_thread::yield();
+    }
+    batch = (batch % 7U) + 1U;
+  }
+  producer.join();
+
+  REQUIRE(errors == 0);
+  REQUIRE(mcpRxRingCount(&ring) == 0);
+  REQUIRE(ring.peak <= MCP_RXRING_SIZE);
+}
@@ -0,0 +1,1232 @@
+#include "catch/catch.hpp"
+#include "../libmcp2515/driver_mcp2515.h"
+#include "../libmcp2515/sim_mcp2515.h"
+#include "../libmcp2515/simbus_mcp2515.h"
+#include "../libmcp2515/spicost_mcp2515.h"
+#include "../libmcp2515/coalesce_mcp2515.h"
+#include "../libmcp2515/config_mcp2515.h"
+#include "../libmcp2515/rxring_mcp2515.h"
+#include "../libmcp2515/service_mcp2515.h"
+#include "../libmcp2515/trace_mcp2515.h"
+#include "string.h"
+
+static const uint8_t REG_CANSTAT  = 0x0E;
+static const uint8_t REG_CANCTRL  = 0x0F;
+static const uint8_t REG_CNF1     = 0x2A;
+static const uint8_t REG_CANINTE  = 0x2B;
+static const uint8_t REG_EFLG     = 0x2D;
+static const uint8_t REG_TXB0CTRL = 0x30;
+static const uint8_t REG_TXB1CTRL = 0x40;
+static const uint8_t REG_RXB0CTRL = 0x60;
+static const uint8_t REG_RXB1CTRL = 0x70;
+
+static uint8_t readRegister(MCP_Instance* ins, uint8_t addr)
+{
+  uint8_t value = 0xFF;
+  REQUIRE(MCP_OK == mcpReadInto(ins, addr, &value, 1));
+  return value;
+}
+
+static void setMode(MCP_Instance* ins, uint8_t mode)
+{
+  REQUIRE(MCP_OK == mcpBitModify(ins, REG_CANCTRL, 0xE0, (uint8_t) (mode << 5)));
+}
+
+// прямой вызов команды статуса (2 байта: команда и ответ)
+static uint8_t status(MCP_Sim* sim, uint8_t cmd)
+{
+  uint8_t data[2] = {cmd, 0};
+  mcpSimChipSelect(sim, true);
+  mcpSimTransaction(sim, &data[0], 2);
+  mcpSimChipSelect(sim, false);
+  return data[1];
+}
+
+TEST_CASE("Simulator registers")
+{
+  MCP_Sim      sim;
+  MCP_Instance ins = {};
+  mcpSimInit(&sim);
+  mcpSimAttach(&sim, &ins);
+
+  // состояние после сброса: режим конфигурации
+  REQUIRE(mcpSimMode(&sim) == MCP_MODE_CONFIG);
+  REQUIRE(readRegister(&ins, REG_CANCTRL) == 0x87);
+  REQUIRE(readRegister(&ins, REG_CANSTAT) == 0x80);
+  REQUIRE(readRegister(&ins, 0x7F) == 0x87);  // зеркало CANCTRL
+
+  // запись и чтение пакетом
+  uint8_t cnf[3] = {0x05, 0xB8, 0x01};
+  REQUIRE(MCP_OK == mcpWrite(&ins, 0x28, &cnf[0], 3));
+  uint8_t* data;
+  REQUIRE(MCP_OK == mcpRead(&ins, 0x28, &data, 3));
+  REQUIRE(0 == memcmp(data, &cnf[0], 3));
+
+  // BIT MODIFY на поддерживающем регистре применяет маску
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_CNF1, 0x0F, 0xFF));
+  REQUIRE(readRegister(&ins, REG_CNF1) == 0x0F);
+
+  // на остальных регистрах BIT MODIFY записывает весь байт
+  REQUIRE(MCP_OK == mcpBitModify(&ins, 0x00, 0x01, 0xA5));
+  REQUIRE(readRegister(&ins, 0x00) == 0xA5);
+
+  // нереализованные биты TXBnSIDL и TXBnDLC не записываются ни WRITE, ни LOAD TX BUFFER
+  uint8_t image[13];
+  memset(&image[0], 0xFF, sizeof(image));
+  REQUIRE(MCP_OK == mcpLoadTxBuffer(&ins, MCP_LOADTXBUFFER_TXB1SIDH, &image[0]));
+  REQUIRE(MCP_OK == mcpWrite(&ins, 0x51, &image[0], sizeof(image)));
+  for (uint8_t base = 0x41; base <= 0x51; base = (uint8_t) (base + 0x10))
+  {
+    REQUIRE(readRegister(&ins, (uint8_t) (base + 0)) == 0xFF);
+    REQUIRE(readRegister(&ins, (uint8_t) (base + 1)) == 0xEB);
+    REQUIRE(readRegister(&ins, (uint8_t) (base + 4)) == 0x4F);
+    REQUIRE(readRegister(&ins, (uint8_t) (base + 12)) == 0xFF);
+  }
+
+  // а если команда LOAD TX BUFFER недопустима (0x46, 0x47)? данные отбрасываются
+  uint8_t stray[8] = {0x46, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77};
+  REQUIRE(MCP_OK == mcpSimTransaction(&sim, &stray[0], sizeof(stray)));
+  stray[0] = 0x47;
+  REQUIRE(MCP_OK == mcpSimTransaction(&sim, &stray[0], sizeof(stray)));
+  REQUIRE(readRegister(&ins, 0x00) == 0xA5);
+  REQUIRE(readRegister(&ins, 0x01) == 0x00);
+  REQUIRE(readRegister(&ins, 0x06) == 0x00);
+
+  // TEC, REC и CANSTAT доступны только для чтения
+  uint8_t counters[2] = {0x11, 0x22};
+  REQUIRE(MCP_OK == mcpWrite(&ins, 0x1C, &counters[0], 2));
+  REQUIRE(readRegister(&ins, 0x1C) == 0);
+  REQUIRE(readRegister(&ins, 0x1D) == 0);
+
+  // смена режима
+  setMode(&ins, MCP_MODE_NORMAL);
+  REQUIRE(mcpSimMode(&sim) == MCP_MODE_NORMAL);
+  REQUIRE((readRegister(&ins, REG_CANSTAT) & 0xE0) == 0x00);
+
+  // а если записать конфигурацию вне режима конфигурации?
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_CNF1, 0xFF, 0x3F));
+  REQUIRE(readRegister(&ins, REG_CNF1) == 0x0F);
+  uint8_t filter = 0x5A;
+  REQUIRE(MCP_OK == mcpWrite(&ins, 0x00, &filter, 1));
+  REQUIRE(readRegister(&ins, 0x00) == 0xA5);
+
+  // RESET возвращает состояние после сброса
+  uint8_t reset = 0xC0;
+  mcpSimChipSelect(&sim, true);
+  mcpSimTransaction(&sim, &reset, 1);
+  mcpSimChipSelect(&sim, false);
+  REQUIRE(mcpSimMode(&sim) == MCP_MODE_CONFIG);
+  REQUIRE(readRegister(&ins, REG_CNF1) == 0);
+
+  REQUIRE(sim.csCycles > 0);
+  REQUIRE(sim.spiBytes > 0);
+}
+
+TEST_CASE("Simulator loopback")
+{
+  MCP_Sim      sim;
+  MCP_Instance ins = {};
+  MCP_Frame    frame;
+  MCP_Frame    rx;
+  mcpSimInit(&sim);
+  mcpSimAttach(&sim, &ins);
+
+  // прием любых сообщений в оба буфера
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_RXB0CTRL, 0x60, 0x60));
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_RXB1CTRL, 0x60, 0x60));
+  setMode(&ins, MCP_MODE_LOOPBACK);
+
+  // расширенный фрейм
+  memset(&frame, 0, sizeof(frame));
+  frame.id    = 0x1DA5678;
+  frame.flags = MCP_FRAME_IDE;
+  frame.dlc   = 8;
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    frame.data[i] = (uint8_t) (i + 1);
+  }
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 0, &frame, nullptr));
+  REQUIRE(sim.reg[0x31] == 0x0E);
+  REQUIRE(sim.reg[0x32] == 0xCA);
+  REQUIRE(status(&sim, 0xA0) == 0x00);
+
+  REQUIRE(MCP_OK == mcpRTS(&ins, MCP_RTSCMD_BUFFER0));
+  REQUIRE(sim.txFrames == 1);
+  REQUIRE(sim.rxFrames == 1);
+  REQUIRE(status(&sim, 0xA0) == 0x09);  // RX0IF и TX0IF
+  REQUIRE(status(&sim, 0xB0) == 0x50);  // RXB0, расширенный фрейм, RXF0
+
+  // READ RX BUFFER сбрасывает RX0IF по окончании транзакции
+  memset(&rx, 0, sizeof(rx));
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &rx));
+  REQUIRE(rx.id == frame.id);
+  REQUIRE(rx.flags == MCP_FRAME_IDE);
+  REQUIRE(rx.dlc == 8);
+  REQUIRE(0 == memcmp(&rx.data[0], &frame.data[0], 8));
+  REQUIRE((readRegister(&ins, MCP_REG_CANINTF) & MCP_CANINTF_RX0IF) == 0);
+
+  // стандартный удаленный запрос в двухфазном режиме
+  memset(&frame, 0, sizeof(frame));
+  frame.id    = 0x7FF;
+  frame.flags = MCP_FRAME_RTR;
+  frame.dlc   = 2;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 1, &frame, nullptr));
+  REQUIRE(MCP_OK == mcpRTS(&ins, MCP_RTSCMD_BUFFER1));
+  REQUIRE(status(&sim, 0xB0) == 0x48);  // RXB0, стандартный удаленный запрос
+  ins.flags = MCP_FLAG_RX_TWOPHASE;
+  memset(&rx, 0xFF, sizeof(rx));
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &rx));
+  REQUIRE(rx.id == 0x7FF);
+  REQUIRE(rx.flags == MCP_FRAME_RTR);
+  REQUIRE(rx.dlc == 2);
+  REQUIRE(readRegister(&ins, MCP_REG_CANINTF) == 0x0C);  // TX0IF и TX1IF
+
+  // приоритет: буфер с большим TXP передается первым
+  setMode(&ins, MCP_MODE_CONFIG);
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_TXB1CTRL, 0x0B, 0x0B));
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_TXB0CTRL, 0x0B, 0x0A));
+  REQUIRE(mcpSimPendingTx(&sim) == 1);
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_TXB0CTRL, 0x03, 0x03));
+  REQUIRE(mcpSimPendingTx(&sim) == 1);  // при равном TXP - больший номер буфера
+  mcpSimTxDone(&sim, 1);
+  REQUIRE(mcpSimPendingTx(&sim) == 0);
+  mcpSimTxDone(&sim, 0);
+  REQUIRE(mcpSimPendingTx(&sim) == -1);
+}
+
+TEST_CASE("Simulator filters")
+{
+  MCP_Sim      sim;
+  MCP_Instance ins = {};
+  MCP_Filters  filters;
+  MCP_Frame    frame;
+  mcpSimInit(&sim);
+  mcpSimAttach(&sim, &ins);
+
+  // RXB0: 0x123 и 0x456 (стандартные), RXB1: только расширенный 0x1DA5678
+  memset(&filters, 0, sizeof(filters));
+  filters.rxf[0][0] = 0x24;
+  filters.rxf[0][1] = 0x60;
+  filters.rxf[1][0] = 0x8A;
+  filters.rxf[1][1] = 0xC0;
+  for (uint8_t i = 2; i < 6; i++)
+  {
+    filters.rxf[i][0] = 0x0E;
+    filters.rxf[i][1] = 0xCA;
+    filters.rxf[i][2] = 0x56;
+    filters.rxf[i][3] = 0x78;
+  }
+  filters.rxm[0][0] = 0xFF;
+  filters.rxm[0][1] = 0xE0;
+  memset(&filters.rxm[1][0], 0xFF, 4);
+  REQUIRE(MCP_OK == mcpWriteFilters(&ins, &filters));
+  REQUIRE(mcpSimMode(&sim) == MCP_MODE_CONFIG);  // CANCTRL не записывается
+  REQUIRE(readRegister(&ins, 0x1B) == 0x78);     // RXF5EID0
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_CANINTE, 0x03, 0x03));
+
+  // в режиме конфигурации фреймы не принимаются
+  memset(&frame, 0, sizeof(frame));
+  frame.id  = 0x123;
+  frame.dlc = 1;
+  REQUIRE_FALSE(mcpSimReceive(&sim, &frame));
+  setMode(&ins, MCP_MODE_NORMAL);
+
+  REQUIRE(mcpSimReceive(&sim, &frame));
+  REQUIRE(mcpSimInterrupt(&sim));
+  REQUIRE((readRegister(&ins, REG_CANSTAT) & 0x0E) == 0x0C);  // ICOD: RXB0
+  REQUIRE(status(&sim, 0xB0) == 0x40);
+
+  // идентификатор не проходит фильтры
+  frame.id = 0x124;
+  REQUIRE_FALSE(mcpSimReceive(&sim, &frame));
+  REQUIRE(sim.rxDropped == 0);
+
+  // стандартный фрейм не проходит фильтр расширенного
+  frame.id = 0x0E6;
+  REQUIRE_FALSE(mcpSimReceive(&sim, &frame));
+
+  // расширенный фрейм принимается в RXB1 фильтром RXF2
+  frame.id    = 0x1DA5678;
+  frame.flags = MCP_FRAME_IDE;
+  REQUIRE(mcpSimReceive(&sim, &frame));
+  REQUIRE(status(&sim, 0xB0) == 0xC0);  // оба буфера, сведения о RXB0
+  REQUIRE((sim.reg[REG_RXB1CTRL] & 0x07) == 2);
+
+  // а если RXB0 занят и перенос в RXB1 запрещен?
+  frame.id    = 0x456;
+  frame.flags = 0;
+  REQUIRE_FALSE(mcpSimReceive(&sim, &frame));
+  REQUIRE(sim.rxDropped == 1);
+  REQUIRE((readRegister(&ins, REG_EFLG) & 0x40) == 0x40);
+
+  // оба фрейма за одну транзакцию, флаги сбрасываются
+  MCP_Frame frames[2];
+  REQUIRE(MCP_OK == mcpReceiveBothFrames(&ins, &frames[0]));
+  REQUIRE(frames[0].id == 0x123);
+  REQUIRE(frames[1].id == 0x1DA5678);
+  REQUIRE_FALSE(mcpSimInterrupt(&sim));
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_EFLG, 0x40, 0x00));
+  REQUIRE(readRegister(&ins, REG_EFLG) == 0);
+
+  // перенос из RXB0 в RXB1 (BUKT)
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_RXB0CTRL, 0x04, 0x04));
+  REQUIRE(mcpSimReceive(&sim, &frame));
+  frame.id = 0x123;
+  REQUIRE(mcpSimReceive(&sim, &frame));
+  REQUIRE(status(&sim, 0xB0) == 0xC1);  // оба буфера, RXF1 в RXB0
+  REQUIRE((sim.reg[REG_RXB0CTRL] & 0x02) == 0x02);
+  uint8_t rx0[14] = {0x90};
+  mcpSimChipSelect(&sim, true);
+  mcpSimTransaction(&sim, &rx0[0], sizeof(rx0));
+  mcpSimChipSelect(&sim, false);
+  REQUIRE(rx0[1] == 0x8A);
+  REQUIRE(status(&sim, 0xB0) == 0x86);  // RXB1, RXF0 с переносом в RXB1
+  REQUIRE(sim.rxFrames == 4);
+
+  // а если фрейм проходит и фильтры RXB1, но RXB0 занят и перенос запрещен?
+  // фрейм теряется (RX0OVR), RXB1 остается свободным
+  mcpSimInit(&sim);
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_RXB0CTRL, 0x60, 0x60));
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_RXB1CTRL, 0x60, 0x60));
+  setMode(&ins, MCP_MODE_NORMAL);
+  REQUIRE(mcpSimReceive(&sim, &frame));
+  REQUIRE_FALSE(mcpSimReceive(&sim, &frame));
+  REQUIRE(readRegister(&ins, MCP_REG_CANINTF) == 0x21);  // RX0IF и ERRIF
+  REQUIRE(readRegister(&ins, REG_EFLG) == 0x40);
+  REQUIRE(sim.rxDropped == 1);
+}
+
+TEST_CASE("Simulator transports")
+{
+  MCP_Sim      sim;
+  MCP_Instance ins = {};
+  MCP_Frame    frame;
+  MCP_Frame    rx;
+  mcpSimInit(&sim);
+
+  memset(&frame, 0, sizeof(frame));
+  frame.id  = 0x321;
+  frame.dlc = 4;
+  memcpy(&frame.data[0], "\x01\x02\x03\x04", 4);
+
+  // транспорт управляет CS: каждый вызов - отдельная транзакция
+  ins.ctx            = &sim;
+  ins.transactionCtx = mcpSimTransaction;
+  ins.flags          = MCP_FLAG_TRANSPORT_CS;
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_RXB0CTRL, 0x60, 0x60));
+  setMode(&ins, MCP_MODE_LOOPBACK);
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 2, &frame, nullptr));
+  REQUIRE(MCP_OK == mcpRTS(&ins, MCP_RTSCMD_BUFFER2));
+  REQUIRE(sim.csCycles == 4);
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &rx));
+  REQUIRE(rx.id == 0x321);
+  REQUIRE(rx.dlc == 4);
+  REQUIRE(0 == memcmp(&rx.data[0], &frame.data[0], 4));
+
+  // векторный транспорт
+  mcpSimAttach(&sim, &ins);
+  ins.flags        = 0;
+  ins.transactionv = mcpSimTransactionv;
+  frame.id         = 0x322;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 0, &frame, nullptr));
+  REQUIRE(MCP_OK == mcpRTS(&ins, MCP_RTSCMD_BUFFER0));
+  memset(&rx, 0, sizeof(rx));
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &rx));
+  REQUIRE(rx.id == 0x322);
+
+  // полнодуплексный транспорт в двухфазном режиме
+  ins.transactionv = nullptr;
+  ins.transfer     = mcpSimTransfer;
+  ins.flags        = MCP_FLAG_RX_TWOPHASE;
+  frame.id         = 0x323;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 1, &frame, nullptr));
+  REQUIRE(MCP_OK == mcpRTS(&ins, MCP_RTSCMD_BUFFER1));
+  memset(&rx, 0, sizeof(rx));
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &rx));
+  REQUIRE(rx.id == 0x323);
+  REQUIRE(rx.dlc == 4);
+  REQUIRE(0 == memcmp(&rx.data[0], &frame.data[0], 4));
+  REQUIRE(sim.txFrames == 3);
+  REQUIRE(sim.rxFrames == 3);
+}
+
+// настройка узла шины: прием любых сообщений, нормальный режим
+static void busNode(MCP_Sim* sim, MCP_Instance* ins)
+{
+  mcpSimInit(sim);
+  mcpSimAttach(sim, ins);
+  REQUIRE(MCP_OK == mcpBitModify(ins, REG_RXB0CTRL, 0x64, 0x64));
+  REQUIRE(MCP_OK == mcpBitModify(ins, REG_RXB1CTRL, 0x60, 0x60));
+  setMode(ins, MCP_MODE_NORMAL);
+}
+
+static uint64_t PaceTime;
+
+static void pace(void* ctx, uint64_t timeNs)
+{
+  (*(uint32_t*) ctx)++;
+  PaceTime = timeNs;
+}
+
+TEST_CASE("Simulator bus")
+{
+  MCP_Frame frame;
+
+  // 34 доминантных бита от SOF до конца CRC: 6 бит-вставок
+  memset(&frame, 0, sizeof(frame));
+  REQUIRE(mcpSimBusFrameBits(&frame) == 53);
+
+  // длительность не меньше суммы полей фрейма без бит-вставок
+  frame.id  = 0x555;
+  frame.dlc = 8;
+  memset(&frame.data[0], 0x55, 8);
+  REQUIRE(mcpSimBusFrameBits(&frame) >= 111);
+  frame.flags = MCP_FRAME_RTR;
+  REQUIRE(mcpSimBusFrameBits(&frame) >= 111 - 64);
+  REQUIRE(mcpSimBusFrameBits(&frame) < 111);  // удаленный запрос передается без данных
+  frame.flags = MCP_FRAME_IDE;
+  REQUIRE(mcpSimBusFrameBits(&frame) >= 131);
+
+  MCP_Sim      sim[3];
+  MCP_Instance ins[3] = {};
+  MCP_SimBus   bus;
+  mcpSimBusInit(&bus, 1000000U);
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    busNode(&sim[i], &ins[i]);
+    REQUIRE(mcpSimBusAttach(&bus, &sim[i]));
+  }
+  REQUIRE_FALSE(mcpSimBusStep(&bus));
+
+  // арбитраж: меньший идентификатор передается первым
+  memset(&frame, 0, sizeof(frame));
+  frame.id  = 0x200;
+  frame.dlc = 2;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins[0], 0, &frame, nullptr));
+  REQUIRE(MCP_OK == mcpRTS(&ins[0], MCP_RTSCMD_BUFFER0));
+  frame.id = 0x100;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins[1], 2, &frame, nullptr));
+  REQUIRE(MCP_OK == mcpRTS(&ins[1], MCP_RTSCMD_BUFFER2));
+  uint32_t bits = mcpSimBusFrameBits(&frame);
+
+  MCP_Frame rx;
+  REQUIRE(mcpSimBusStep(&bus));
+  REQUIRE(bus.lost == 1);
+  REQUIRE(mcpSimBusTimeNs(&bus) == bits * 1000U);
+  REQUIRE(sim[1].txFrames == 1);
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins[2], 0, &rx));
+  REQUIRE(rx.id == 0x100);
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins[0], 0, &rx));
+  REQUIRE(rx.id == 0x100);
+
+  REQUIRE(1 == mcpSimBusRun(&bus, 10));
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins[2], 0, &rx));
+  REQUIRE(rx.id == 0x200);
+  REQUIRE((readRegister(&ins[1], MCP_REG_CANINTF) & MCP_CANINTF_RX0IF) == MCP_CANINTF_RX0IF);
+  REQUIRE(sim[2].rxFrames == 2);
+
+  // стандартный фрейм выигрывает у расширенного с тем же базовым идентификатором
+  frame.id    = 0x100 << 18;
+  frame.flags = MCP_FRAME_IDE;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins[0], 0, &frame, nullptr));
+  REQUIRE(MCP_OK == mcpRTS(&ins[0], MCP_RTSCMD_BUFFER0));
+  frame.id    = 0x100;
+  frame.flags = MCP_FRAME_RTR;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins[2], 0, &frame, nullptr));
+  REQUIRE(MCP_OK == mcpRTS(&ins[2], MCP_RTSCMD_BUFFER0));
+  REQUIRE(mcpSimBusStep(&bus));
+  REQUIRE(sim[2].txFrames == 1);
+  REQUIRE(sim[0].txFrames == 1);
+
+  // а если узел в режиме конфигурации?
+  setMode(&ins[0], MCP_MODE_CONFIG);
+  REQUIRE_FALSE(mcpSimBusStep(&bus));
+  setMode(&ins[0], MCP_MODE_NORMAL);
+  REQUIRE(mcpSimBusStep(&bus));
+
+  // переполнение приемных буферов узла, который не читает фреймы
+  REQUIRE(sim[1].rxDropped == 1);
+  REQUIRE(bus.frames == 4);
+
+  // синхронизация с реальным временем вызывается после каждого фрейма
+  uint32_t paced = 0;
+  bus.pace       = pace;
+  bus.paceCtx    = &paced;
+  REQUIRE(MCP_OK == mcpRTS(&ins[1], MCP_RTSCMD_BUFFER2));
+  REQUIRE(1 == mcpSimBusRun(&bus, 10));
+  REQUIRE(paced == 1);
+  REQUIRE(PaceTime == mcpSimBusTimeNs(&bus));
+}
+
+TEST_CASE("SPI cost model")
+{
+  MCP_Sim      sim;
+  MCP_Instance ins = {};
+  MCP_SpiCost  cost;
+  MCP_Frame    frame;
+  mcpSimInit(&sim);
+  mcpSimAttach(&sim, &ins);
+  REQUIRE(MCP_OK == mcpSpiCostInit(&cost, 10000000U, 200U));
+  mcpSpiCostAttach(&cost, &ins);
+  REQUIRE(ins.ctx == &cost);
+  REQUIRE(ins.transactionv == nullptr);
+  REQUIRE(ins.transfer == nullptr);
+
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_RXB0CTRL, 0x60, 0x60));
+  setMode(&ins, MCP_MODE_LOOPBACK);
+  REQUIRE(cost.ops[MCP_COMMAND_BITMODIFY].frames == 2);
+  mcpSpiCostReset(&cost);
+
+  // полный цикл фрейма: загрузка, RTS, опрос статуса, чтение, сброс флага
+  memset(&frame, 0, sizeof(frame));
+  frame.id  = 0x123;
+  frame.dlc = 8;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 0, &frame, nullptr));
+  REQUIRE(MCP_OK == mcpRTS(&ins, MCP_RTSCMD_BUFFER0));
+  uint8_t flags = 0;
+  REQUIRE(MCP_OK == mcpReadStatusInto(&ins, &flags, nullptr));
+  REQUIRE((flags & (MCP_STATUS_RX0IF | MCP_STATUS_TX0IF)) == (MCP_STATUS_RX0IF | MCP_STATUS_TX0IF));
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &frame));
+  REQUIRE(MCP_OK == mcpBitModify(&ins, MCP_REG_CANINTF, 0x04, 0x00));
+  REQUIRE(frame.id == 0x123);
+
+  REQUIRE(cost.ops[MCP_COMMAND_LOADTX].frames == 1);
+  REQUIRE(cost.ops[MCP_COMMAND_LOADTX].bytes == 14);
+  REQUIRE(cost.ops[MCP_COMMAND_RTS].bytes == 1);
+  REQUIRE(cost.ops[MCP_COMMAND_READSTATUS].frames == 1);
+  REQUIRE(cost.ops[MCP_COMMAND_READSTATUS].bytes == 2);
+  REQUIRE(cost.ops[MCP_COMMAND_READRX].bytes == 14);
+  REQUIRE(cost.ops[MCP_COMMAND_BITMODIFY].bytes == 4);
+  REQUIRE(cost.ops[MCP_COMMAND_OTHER].frames == 0);
+
+  // 14 байт по 100 нс на бит и 200 нс на выбор микросхемы
+  REQUIRE(mcpSpiCostTimeNs(&cost, MCP_COMMAND_LOADTX) == 14 * 800 + 200);
+  uint64_t total = (14 + 1 + cost.ops[MCP_COMMAND_READSTATUS].bytes + 14 + 4) * 800 + 5 * 200;
+  REQUIRE(mcpSpiCostTimeNs(&cost, MCP_COMMAND_TYPES) == total);
+  REQUIRE(mcpSpiCostFramesPerSecond(&cost, 1, 1) == 1000000000U / total);
+  REQUIRE(mcpSpiCostFramesPerSecond(&cost, 1, 4) == 1000000000U / (4 * total));
+
+  // двухфазное чтение: две части одной транзакции учитываются один раз
+  ins.flags = MCP_FLAG_RX_TWOPHASE;
+  mcpSpiCostReset(&cost);
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 0, &frame, nullptr));
+  REQUIRE(MCP_OK == mcpRTS(&ins, MCP_RTSCMD_BUFFER0));
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &frame));
+  REQUIRE(cost.ops[MCP_COMMAND_READRX].frames == 1);
+  REQUIRE(cost.ops[MCP_COMMAND_READRX].bytes == 14);
+
+  // а если микросхему выбирает транспорт?
+  MCP_Instance tcs = {};
+  tcs.ctx            = &sim;
+  tcs.transactionCtx = mcpSimTransaction;
+  tcs.flags          = MCP_FLAG_TRANSPORT_CS;
+  REQUIRE(MCP_OK == mcpSpiCostInit(&cost, 10000000U, 200U));
+  mcpSpiCostAttach(&cost, &tcs);
+  REQUIRE(MCP_OK == mcpBitModify(&tcs, MCP_REG_CANINTF, 0x04, 0x00));
+  REQUIRE(MCP_OK == mcpRTS(&tcs, MCP_RTSCMD_BUFFER0));
+  REQUIRE(cost.ops[MCP_COMMAND_BITMODIFY].frames == 1);
+  REQUIRE(cost.ops[MCP_COMMAND_RTS].frames == 1);
+  REQUIRE(sim.txFrames == 3);
+
+  // векторный транспорт
+  MCP_Instance vec = {};
+  mcpSimAttach(&sim, &vec);
+  vec.transactionv = mcpSimTransactionv;
+  REQUIRE(MCP_OK == mcpSpiCostInit(&cost, 10000000U, 200U));
+  mcpSpiCostAttach(&cost, &vec);
+  REQUIRE(vec.transactionv != nullptr);
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&vec, 0, &frame, nullptr));
+  REQUIRE(cost.ops[MCP_COMMAND_LOADTX].frames == 1);
+  REQUIRE(cost.ops[MCP_COMMAND_LOADTX].bytes == 14);
+
+  // а если частота SCK равна 0?
+  MCP_SpiCost zero;
+  REQUIRE(MCP_ERROR == mcpSpiCostInit(&zero, 0, 200U));
+  mcpSpiCostAttach(&zero, &vec);
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&vec, 0, &frame, nullptr));
+  REQUIRE(zero.ops[MCP_COMMAND_LOADTX].bytes == 14);
+  REQUIRE(mcpSpiCostTimeNs(&zero, MCP_COMMAND_TYPES) == 0);
+  REQUIRE(mcpSpiCostFramesPerSecond(&zero, 1, 1) == 0);
+}
+
+static uint32_t TraceClock;
+
+static uint32_t traceClock()
+{
+  return ++TraceClock;
+}
+
+TEST_CASE("SPI trace")
+{
+  MCP_Sim      sim;
+  MCP_Instance ins = {};
+  MCP_Trace    trace;
+  MCP_Frame    frame;
+  uint8_t      ring[1024];
+  uint8_t      data[1024];
+  mcpSimInit(&sim);
+  mcpSimAttach(&sim, &ins);
+  ins.transactionv = mcpSimTransactionv;
+  REQUIRE(MCP_ERROR == mcpTraceInit(&trace, ring, 1000));
+  REQUIRE(MCP_OK == mcpTraceInit(&trace, ring, sizeof(ring)));
+  trace.clock = traceClock;
+  mcpTraceAttach(&trace, &ins);
+  REQUIRE(ins.ctx == &trace);
+  REQUIRE(ins.transfer == nullptr);
+
+  // запись: фрейм через петлю
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_RXB0CTRL, 0x60, 0x60));
+  setMode(&ins, MCP_MODE_LOOPBACK);
+  memset(&frame, 0, sizeof(frame));
+  frame.id      = 0x2A5;
+  frame.dlc     = 3;
+  frame.data[0] = 0x11;
+  frame.data[2] = 0x33;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 0, &frame, nullptr));
+  REQUIRE(MCP_OK == mcpRTS(&ins, MCP_RTSCMD_BUFFER0));
+  memset(&frame, 0, sizeof(frame));
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &frame));
+  REQUIRE(trace.dropped == 0);
+
+  // данные забираются частями
+  uint32_t size = mcpTraceRead(&trace, data, 7);
+  REQUIRE(size == 7);
+  REQUIRE(data[0] == MCP_TRACE_SELECT);
+  REQUIRE(data[1] == 1);
+  size += mcpTraceRead(&trace, &data[size], sizeof(data) - size);
+  REQUIRE(mcpTraceRead(&trace, data, sizeof(data)) == 0);
+  REQUIRE(size > 14 + 2 * MCP_TRACE_DATA_SIZE);
+
+  // воспроизведение без микросхемы
+  MCP_Instance    rep = {};
+  MCP_TraceReplay replay;
+  MCP_Frame       copy;
+  rep.transactionv = mcpSimTransactionv;
+  mcpTraceReplayInit(&replay, data, size);
+  mcpTraceReplayAttach(&replay, &rep);
+  REQUIRE(rep.ctx == &replay);
+  REQUIRE(rep.transactionv != mcpSimTransactionv);
+  REQUIRE(MCP_OK == mcpBitModify(&rep, REG_RXB0CTRL, 0x60, 0x60));
+  setMode(&rep, MCP_MODE_LOOPBACK);
+  copy       = frame;
+  copy.flags = 0;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&rep, 0, &copy, nullptr));
+  REQUIRE(MCP_OK == mcpRTS(&rep, MCP_RTSCMD_BUFFER0));
+  memset(&copy, 0, sizeof(copy));
+  REQUIRE(MCP_OK == mcpReceiveFrame(&rep, 0, &copy));
+  REQUIRE(copy.id == 0x2A5);
+  REQUIRE(copy.dlc == 3);
+  REQUIRE(copy.data[2] == 0x33);
+  REQUIRE(replay.mismatches == 0);
+  REQUIRE(mcpTraceReplayDone(&replay));
+  REQUIRE(replay.timestamp == TraceClock);
+
+  // а если драйвер отклонился от трассы?
+  mcpTraceReplayInit(&replay, data, size);
+  REQUIRE(MCP_OK == mcpBitModify(&rep, REG_RXB0CTRL, 0x60, 0x00));
+  REQUIRE(replay.mismatches == 1);
+  rep.flags = MCP_FLAG_TRANSPORT_CS;
+  REQUIRE(MCP_ERROR == mcpRTS(&rep, MCP_RTSCMD_BUFFER0));
+  REQUIRE(replay.mismatches == 2);
+
+  // а если трасса закончилась?
+  mcpTraceReplayInit(&replay, data, MCP_TRACE_EVENT_SIZE + MCP_TRACE_DATA_SIZE + 2);
+  rep.flags = 0;
+  REQUIRE(MCP_ERROR == mcpBitModify(&rep, REG_RXB0CTRL, 0x60, 0x60));
+  REQUIRE(replay.mismatches == 2);
+
+  // а если буфер переполнен? запись отбрасывается, обмен продолжается
+  MCP_Trace small;
+  REQUIRE(MCP_OK == mcpTraceInit(&small, ring, 16));
+  mcpTraceAttach(&small, &ins);
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 0, &frame, nullptr));
+  REQUIRE(small.dropped == 1);
+  REQUIRE(mcpTraceRead(&small, data, sizeof(data)) == 2 * MCP_TRACE_EVENT_SIZE);
+  REQUIRE(sim.reg[0x31] == (uint8_t) (0x2A5 >> 3));
+}
+
+static MCP_Frame Received[4];
+static uint32_t  ReceivedCount;
+
+static void receive(void* ctx, const MCP_Frame* frame)
+{
+  (void) ctx;
+  Received[ReceivedCount++ & 3] = *frame;
+}
+
+static uint8_t FailLength;
+
+/// @brief Транзакция симулятора, завершающаяся ошибкой при длине FailLength
+static int32_t failingTransaction(void* ctx, uint8_t* data, uint8_t len)
+{
+  if (len == FailLength)
+  {
+    return MCP_ERROR;
+  }
+  return mcpSimTransaction(ctx, data, len);
+}
+
+TEST_CASE("Service loop")
+{
+  MCP_Sim      sim;
+  MCP_Instance ins = {};
+  MCP_Service  svc;
+  MCP_Frame    frame;
+  mcpSimInit(&sim);
+  mcpSimAttach(&sim, &ins);
+  mcpServiceInit(&svc, &ins);
+  svc.receive   = receive;
+  ReceivedCount = 0;
+
+  // прием без фильтров с переходом в RXB1
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_RXB0CTRL, 0x64, 0x64));
+  setMode(&ins, MCP_MODE_LOOPBACK);
+
+  // пустая итерация - только READ STATUS
+  REQUIRE(MCP_OK == mcpService(&svc));
+  REQUIRE(svc.csCycles == 1);
+  REQUIRE(svc.spiBytes == 2);
+
+  memset(&frame, 0, sizeof(frame));
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    frame.id  = 0x100U + i;
+    frame.dlc = (uint8_t) (i + 1U);
+    REQUIRE(MCP_OK == mcpServiceSend(&svc, &frame));
+  }
+
+  // загрузка двух буферов, приоритет TXB0 и одна команда RTS на оба
+  uint32_t cycles = sim.csCycles;
+  uint32_t bytes  = sim.spiBytes;
+  REQUIRE(MCP_OK == mcpService(&svc));
+  REQUIRE(svc.csCycles == 5);
+  REQUIRE(svc.spiBytes == 2 + (6 + 1) + (6 + 2) + 4 + 1);
+  REQUIRE(svc.txp[0] == 3);
+  REQUIRE(svc.txp[1] == 0);
+  REQUIRE(sim.csCycles - cycles == svc.csCycles);
+  REQUIRE(sim.spiBytes - bytes == svc.spiBytes);
+  REQUIRE(svc.pending == 0x03);
+  REQUIRE(svc.count == 0);
+  REQUIRE(sim.txFrames == 2);
+
+  // прием двух фреймов и сброс TXnIF одной командой
+  cycles = sim.csCycles;
+  bytes  = sim.spiBytes;
+  REQUIRE(MCP_OK == mcpService(&svc));
+  REQUIRE(svc.status == (MCP_STATUS_RX0IF | MCP_STATUS_RX1IF | MCP_STATUS_TX0IF | MCP_STATUS_TX1IF));
+  REQUIRE(svc.csCycles == 4);
+  REQUIRE(svc.spiBytes == 2 + 14 + 14 + 4);
+  REQUIRE(sim.csCycles - cycles == svc.csCycles);
+  REQUIRE(sim.spiBytes - bytes == svc.spiBytes);
+  REQUIRE(svc.rxFrames == 2);
+  REQUIRE(svc.txFrames == 2);
+  REQUIRE(svc.pending == 0);
+  REQUIRE(ReceivedCount == 2);
+  REQUIRE(Received[0].id + Received[1].id == 0x201);
+  REQUIRE(sim.reg[MCP_REG_CANINTF] == 0);
+
+  REQUIRE(MCP_OK == mcpService(&svc));
+  REQUIRE(svc.csCycles == 1);
+
+  // двухфазное чтение экономит байты пустого поля данных
+  ins.flags = MCP_FLAG_RX_TWOPHASE;
+  frame.dlc = 0;
+  REQUIRE(MCP_OK == mcpServiceSend(&svc, &frame));
+  REQUIRE(MCP_OK == mcpService(&svc));
+  REQUIRE(MCP_OK == mcpService(&svc));
+  REQUIRE(svc.spiBytes == 2 + 6 + 4);
+  REQUIRE(svc.rxFrames == 3);
+
+  // а если вторая фаза приема завершилась ошибкой?
+  frame.dlc = 3;
+  REQUIRE(MCP_OK == mcpServiceSend(&svc, &frame));
+  REQUIRE(MCP_OK == mcpService(&svc));
+  ins.transactionCtx = failingTransaction;
+  FailLength         = 3;
+  REQUIRE(MCP_ERROR == mcpService(&svc));
+  REQUIRE(svc.csCycles == 2);
+#ifdef MCP_STATISTICS
+  // учитываются байты, переданные транспорту
+  REQUIRE(svc.spiBytes == 2 + 6 + 3);
+#else
+  // длина второй фазы неизвестна
+  REQUIRE(svc.spiBytes == 2 + 6);
+#endif
+  // RXnIF сброшен по окончании транзакции: фрейм потерян
+  ins.transactionCtx = mcpSimTransaction;
+  REQUIRE(MCP_OK == mcpService(&svc));
+  REQUIRE(svc.rxFrames == 3);
+
+  // а если очередь заполнена?
+  for (uint8_t i = 0; i < MCP_SERVICE_TXQUEUE; i++)
+  {
+    REQUIRE(MCP_OK == mcpServiceSend(&svc, &frame));
+  }
+  REQUIRE(MCP_ERROR_BUFFER == mcpServiceSend(&svc, &frame));
+}
+
+TEST_CASE("Service receive ring")
+{
+  MCP_Sim           sim;
+  MCP_Instance      ins = {};
+  MCP_Service       svc;
+  static MCP_RxRing ring;
+  MCP_Frame         frame;
+  MCP_Frame         frames[4];
+  mcpSimInit(&sim);
+  mcpSimAttach(&sim, &ins);
+  mcpServiceInit(&svc, &ins);
+  mcpRxRingInit(&ring);
+  svc.receive = mcpRxRingReceive;
+  svc.ctx     = &ring;
+
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_RXB0CTRL, 0x64, 0x64));
+  setMode(&ins, MCP_MODE_LOOPBACK);
+
+  // фреймы остаются в очереди после последующих вызовов драйвера
+  memset(&frame, 0, sizeof(frame));
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    frame.id      = 0x300U + i;
+    frame.dlc     = 1;
+    frame.data[0] = i;
+    REQUIRE(MCP_OK == mcpServiceSend(&svc, &frame));
+    REQUIRE(MCP_OK == mcpService(&svc));
+    REQUIRE(MCP_OK == mcpService(&svc));
+  }
+  REQUIRE(mcpRxRingCount(&ring) == 3);
+  REQUIRE(mcpRxRingPop(&ring, frames, 4) == 3);
+  REQUIRE(frames[0].id == 0x300);
+  REQUIRE(frames[2].data[0] == 2);
+  REQUIRE(ring.overflows == 0);
+}
+
+/// @brief Передает все ожидающие фреймы симулятора и возвращает их идентификаторы
+static uint32_t drainTx(MCP_Sim* sim, uint32_t* ids, uint32_t max)
+{
+  uint32_t count = 0;
+  int8_t   txb;
+  while (((txb = mcpSimPendingTx(sim)) >= 0) && (count < max))
+  {
+    MCP_Frame frame;
+    mcpSimTxFrame(sim, (uint8_t) txb, &frame);
+    mcpSimTxDone(sim, (uint8_t) txb);
+    ids[count++] = frame.id | ((uint32_t) frame.data[0] << 24);
+  }
+  return count;
+}
+
+TEST_CASE("Service priority")
+{
+  MCP_Sim      sim;
+  MCP_Instance ins = {};
+  MCP_Service  svc;
+  MCP_Frame    frame;
+  uint32_t     ids[4];
+  mcpSimInit(&sim);
+  mcpSimAttach(&sim, &ins);
+  mcpServiceInit(&svc, &ins);
+  setMode(&ins, MCP_MODE_NORMAL);
+
+  memset(&frame, 0, sizeof(frame));
+  const uint32_t order[4] = {0x300, 0x100, 0x200, 0x050};
+  for (uint32_t id : order)
+  {
+    frame.id = id;
+    REQUIRE(MCP_OK == mcpServiceSend(&svc, &frame));
+  }
+
+  // в буферы попадают три лучших фрейма, TXP задает порядок передачи
+  REQUIRE(MCP_OK == mcpService(&svc));
+  REQUIRE(svc.pending == 0x07);
+  REQUIRE(svc.count == 1);
+  REQUIRE(svc.txp[0] == 3);
+  REQUIRE(svc.txp[1] == 2);
+  REQUIRE(svc.txp[2] == 0);
+  REQUIRE(drainTx(&sim, ids, 1) == 1);
+  REQUIRE(ids[0] == 0x050);
+
+  // освободившийся буфер сразу загружается худшим фреймом
+  REQUIRE(MCP_OK == mcpService(&svc));
+  REQUIRE(svc.txFrames == 1);
+  REQUIRE(svc.pending == 0x07);
+  REQUIRE(svc.count == 0);
+  REQUIRE(drainTx(&sim, ids, 4) == 3);
+  REQUIRE(ids[0] == 0x100);
+  REQUIRE(ids[1] == 0x200);
+  REQUIRE(ids[2] == 0x300);
+
+  // расширенный фрейм проигрывает стандартному с тем же базовым
+  // идентификатором, фреймы с одинаковым ключом передаются по порядку
+  REQUIRE(MCP_OK == mcpService(&svc));
+  REQUIRE(svc.txFrames == 4);
+  frame.id    = 0x080U << 18;
+  frame.flags = MCP_FRAME_IDE;
+  REQUIRE(MCP_OK == mcpServiceSend(&svc, &frame));
+  frame.id    = 0x080;
+  frame.flags = 0;
+  for (uint8_t i = 1; i <= 2; i++)
+  {
+    frame.data[0] = i;
+    frame.dlc     = 1;
+    REQUIRE(MCP_OK == mcpServiceSend(&svc, &frame));
+  }
+  REQUIRE(MCP_OK == mcpService(&svc));
+  REQUIRE(drainTx(&sim, ids, 4) == 3);
+  REQUIRE(ids[0] == (0x080U | (1U << 24)));
+  REQUIRE(ids[1] == (0x080U | (2U << 24)));
+  REQUIRE(ids[2] == (0x080U << 18));
+}
+
+TEST_CASE("Register shadow")
+{
+  MCP_Sim      sim;
+  MCP_Instance ins    = {};
+  MCP_Shadow   shadow = {};
+  uint8_t      cnf[3] = {0x05, 0xB1, 0x82};
+  uint8_t      regs[3];
+  uint8_t*     data;
+  mcpSimInit(&sim);
+  mcpSimAttach(&sim, &ins);
+  ins.shadow = &shadow;
+
+  // режим неизвестен: записанные CNF не кэшируются
+  REQUIRE(MCP_OK == mcpWrite(&ins, REG_CNF1 - 2, cnf, 3));
+  REQUIRE(MCP_OK == mcpReadInto(&ins, REG_CNF1 - 2, regs, 3));
+  REQUIRE(shadow.hits == 0);
+  REQUIRE(shadow.misses == 1);
+
+  // после чтения значения известны, повторное чтение - без обращения к шине
+  uint32_t cycles = sim.csCycles;
+  REQUIRE(MCP_OK == mcpRead(&ins, REG_CNF1 - 2, &data, 3));
+  REQUIRE(0 == memcmp(data, cnf, 3));
+  REQUIRE(sim.csCycles == cycles);
+  REQUIRE(shadow.hits == 1);
+
+  // CANCTRL известен и запрашивает режим конфигурации: запись кэшируется
+  REQUIRE(readRegister(&ins, REG_CANCTRL) == 0x87);
+  cnf[0] = 0x03;
+  REQUIRE(MCP_OK == mcpWrite(&ins, REG_CNF1 - 2, cnf, 1));
+  REQUIRE(readRegister(&ins, REG_CNF1 - 2) == 0x03);
+  REQUIRE(readRegister(&ins, 0x3F) == 0x87);
+  REQUIRE(shadow.hits == 3);
+  REQUIRE(sim.csCycles == cycles + 2);
+
+  // регистры, изменяемые микросхемой, всегда читаются по шине
+  cycles = sim.csCycles;
+  REQUIRE(MCP_OK == mcpRead(&ins, REG_CANSTAT, &data, 2));
+  REQUIRE(data[1] == 0x87);
+  readRegister(&ins, MCP_REG_CANINTF);
+  REQUIRE(sim.csCycles == cycles + 2);
+  REQUIRE(shadow.misses == 3);
+
+  // BIT MODIFY неизвестного регистра не делает его известным
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_CANINTE, 0x03, 0x01));
+  REQUIRE(readRegister(&ins, REG_CANINTE) == 0x01);
+  REQUIRE(MCP_OK == mcpBitModify(&ins, REG_CANINTE, 0x06, 0x06));
+  cycles = sim.csCycles;
+  REQUIRE(readRegister(&ins, REG_CANINTE) == 0x07);
+  REQUIRE(sim.csCycles == cycles);
+
+  // фильтры не поддерживают BIT MODIFY: микросхема записывает весь регистр
+  REQUIRE(MCP_OK == mcpBitModify(&ins, 0x00, 0x0F, 0xA5));
+  cycles = sim.csCycles;
+  REQUIRE(readRegister(&ins, 0x00) == 0xA5);
+  REQUIRE(sim.csCycles == cycles);
+  REQUIRE(sim.reg[0x00] == 0xA5);
+
+  // а если микросхема не в режиме конфигурации? запись игнорируется
+  setMode(&ins, MCP_MODE_NORMAL);
+  cnf[0] = 0x3F;
+  REQUIRE(MCP_OK == mcpWrite(&ins, REG_CNF1 - 2, cnf, 1));
+  REQUIRE(readRegister(&ins, REG_CNF1 - 2) == 0x03);
+  REQUIRE(readRegister(&ins, REG_CNF1) == 0x82);
+
+  // после сброса все значения неизвестны
+  mcpShadowInvalidate(&shadow);
+  uint32_t misses = shadow.misses;
+  REQUIRE(readRegister(&ins, REG_CNF1) == 0x82);
+  REQUIRE(shadow.misses == misses + 1);
+
+  // векторный транспорт: запись и чтение без копирования в buffer
+  ins.transactionv = mcpSimTransactionv;
+  regs[0]          = 0x1C;
+  REQUIRE(MCP_OK == mcpWrite(&ins, REG_CANINTE, regs, 1));
+  cycles = sim.csCycles;
+  REQUIRE(readRegister(&ins, REG_CANINTE) == 0x1C);
+  REQUIRE(readRegister(&ins, REG_CNF1) == 0x82);
+  REQUIRE(sim.csCycles == cycles);
+}
+
+static int32_t failTransaction(void* ctx, uint8_t* data, uint8_t len)
+{
+  (void) ctx;
+  (void) data;
+  (void) len;
+  return MCP_ERROR;
+}
+
+TEST_CASE("Bit-modify coalescing")
+{
+  MCP_Sim      sim;
+  MCP_Instance ins    = {};
+  MCP_Shadow   shadow = {};
+  MCP_Coalesce co;
+  mcpSimInit(&sim);
+  mcpSimAttach(&sim, &ins);
+  mcpCoalesceInit(&co, &ins);
+
+  // изменения одного регистра объединяются в один BIT MODIFY
+  uint32_t cycles = sim.csCycles;
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, REG_CANINTE, 0x03, 0x01));
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, REG_CANINTE, 0x06, 0x06));
+  REQUIRE(sim.csCycles == cycles);
+  REQUIRE(co.merged == 1);
+  REQUIRE(MCP_OK == mcpCoalesceCommit(&co));
+  REQUIRE(sim.csCycles == cycles + 1);
+  REQUIRE(co.modifies == 1);
+  REQUIRE(readRegister(&ins, REG_CANINTE) == 0x07);
+
+  // регистры с полной маской записываются одной пакетной командой WRITE,
+  // независимо от порядка изменений
+  cycles = sim.csCycles;
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, REG_CNF1, 0xFF, 0x82));
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, REG_CNF1 - 2, 0xFF, 0x05));
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, REG_CNF1 - 1, 0xFF, 0xB1));
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, REG_CANINTE, 0x18, 0x08));
+  REQUIRE(MCP_OK == mcpCoalesceCommit(&co));
+  REQUIRE(sim.csCycles == cycles + 2);
+  REQUIRE(co.writes == 1);
+  REQUIRE(co.modifies == 2);
+  REQUIRE(sim.reg[REG_CNF1 - 2] == 0x05);
+  REQUIRE(sim.reg[REG_CNF1 - 1] == 0xB1);
+  REQUIRE(sim.reg[REG_CNF1] == 0x82);
+  REQUIRE(sim.reg[REG_CANINTE] == 0x0F);
+
+  // значение из теневой копии позволяет включить регистр в пакетную запись
+  ins.shadow = &shadow;
+  REQUIRE(readRegister(&ins, REG_CANINTE) == 0x0F);
+  cycles = sim.csCycles;
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, REG_CNF1 - 2, 0xFF, 0x03));
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, REG_CNF1 - 1, 0xFF, 0xB8));
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, REG_CNF1, 0xFF, 0x01));
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, REG_CANINTE, 0x03, 0x00));
+  REQUIRE(MCP_OK == mcpCoalesceCommit(&co));
+  REQUIRE(sim.csCycles == cycles + 1);
+  REQUIRE(co.writes == 2);
+  REQUIRE(sim.reg[REG_CNF1 - 2] == 0x03);
+  REQUIRE(sim.reg[REG_CNF1 - 1] == 0xB8);
+  REQUIRE(sim.reg[REG_CNF1] == 0x01);
+  REQUIRE(sim.reg[REG_CANINTE] == 0x0C);
+
+  // несмежные регистры записываются отдельными командами
+  cycles = sim.csCycles;
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, REG_CNF1 - 2, 0xFF, 0x05));
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, REG_CNF1, 0xFF, 0x82));
+  REQUIRE(MCP_OK == mcpCoalesceCommit(&co));
+  REQUIRE(sim.csCycles == cycles + 2);
+  REQUIRE(co.writes == 4);
+
+  // а если регистр не поддерживает BIT MODIFY? микросхема записала бы его
+  // целиком, поэтому частичная маска без известного значения отклоняется
+  ins.shadow = nullptr;
+  REQUIRE(MCP_ERROR == mcpCoalesceModify(&co, 0x00, 0x0F, 0x05));
+  REQUIRE(co.count == 0);
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, 0x00, 0xFF, 0x50));
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, 0x00, 0x0F, 0x05));
+  REQUIRE(MCP_OK == mcpCoalesceCommit(&co));
+  REQUIRE(sim.reg[0x00] == 0x55);
+
+  // значение из теневой копии дополняет частичную маску до полной записи
+  ins.shadow = &shadow;
+  REQUIRE(readRegister(&ins, 0x01) == 0x00);
+  sim.reg[0x01] = 0xA0;
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, 0x01, 0x0F, 0x03));
+  mcpShadowInvalidate(&shadow);
+  REQUIRE(MCP_OK == mcpCoalesceCommit(&co));
+  REQUIRE(co.writes == 6);
+  REQUIRE(sim.reg[0x01] == 0x03);
+
+  // а если заняты все регистры? новый адрес не принимается, но изменение
+  // уже накопленного регистра объединяется
+  for (uint8_t i = 0; i < MCP_COALESCE_SLOTS; i++)
+  {
+    REQUIRE(MCP_OK == mcpCoalesceModify(&co, (uint8_t) (0x20U + i), 0xFF, i));
+  }
+  REQUIRE(MCP_ERROR_BUFFER == mcpCoalesceModify(&co, 0x00, 0xFF, 0x00));
+  REQUIRE(MCP_OK == mcpCoalesceModify(&co, 0x20, 0x0F, 0x0A));
+  REQUIRE(co.count == MCP_COALESCE_SLOTS);
+
+  // а если транзакция неуспешна? ошибка возвращается, очередь сбрасывается
+  ins.transactionCtx = failTransaction;
+  ins.transactionv   = NULL;
+  ins.transfer       = NULL;
+  REQUIRE(MCP_ERROR == mcpCoalesceCommit(&co));
+  REQUIRE(co.count == 0);
+}
+
+TEST_CASE("Configuration diff")
+{
+  MCP_Sim        sim;
+  MCP_Instance   ins    = {};
+  MCP_Shadow     shadow = {};
+  MCP_Config     target = {};
+  MCP_ConfigDiff diff;
+  mcpSimInit(&sim);
+  mcpSimAttach(&sim, &ins);
+
+  target.rxf[0][0] = 0x12;
+  target.rxf[0][1] = 0x08;
+  target.rxm[0][0] = 0xFF;
+  target.rxm[0][1] = 0xE0;
+  target.cnf1      = 0x00;
+  target.cnf2      = 0xB1;
+  target.cnf3      = 0x05;
+  target.caninte   = 0x03;
+  target.rxb0ctrl  = 0x04;
+
+  // состояние неизвестно: три пакетных чтения (при большом буфере - одно)
+  const uint32_t reads  = (MCP_BUFFER_SIZE > 0x72) ? 1 : 3;
+  uint32_t       cycles = sim.csCycles;
+  REQUIRE(MCP_OK == mcpConfigDiff(&ins, &target, NULL, &diff));
+  REQUIRE(sim.csCycles == cycles + reads);
+  REQUIRE(diff.count == 8);
+  REQUIRE(diff.configMode);
+
+  // запись: RXF0, RXM0..CANINTE и RXB0CTRL
+  cycles = sim.csCycles;
+  REQUIRE(MCP_OK == mcpConfigApply(&ins, &target, &diff));
+  REQUIRE(sim.csCycles == cycles + 3);
+  REQUIRE(sim.reg[0x01] == 0x08);
+  REQUIRE(sim.reg[0x21] == 0xE0);
+  REQUIRE(sim.reg[0x29] == 0xB1);
+  REQUIRE(sim.reg[REG_CANINTE] == 0x03);
+  REQUIRE(sim.reg[REG_RXB0CTRL] == 0x04);
+
+  // после применения отличий нет
+  REQUIRE(MCP_OK == mcpConfigDiff(&ins, &target, NULL, &diff));
+  REQUIRE(diff.count == 0);
+  REQUIRE_FALSE(diff.configMode);
+
+  // известное состояние: сравнение без обращения к шине, совпадающие
+  // регистры между отличающимися записываются в том же пакете
+  MCP_Config next = target;
+  next.rxf[0][0]  = 0x13;
+  next.rxf[2][3]  = 0x55;
+  next.rxf[3][0]  = 0x20;
+  cycles          = sim.csCycles;
+  REQUIRE(MCP_OK == mcpConfigDiff(&ins, &next, &target, &diff));
+  REQUIRE(sim.csCycles == cycles);
+  REQUIRE(diff.count == 3);
+  REQUIRE(MCP_OK == mcpConfigApply(&ins, &next, &diff));
+  REQUIRE(sim.csCycles == cycles + 2);
+  REQUIRE(sim.reg[0x00] == 0x13);
+  REQUIRE(sim.reg[0x0B] == 0x55);
+  REQUIRE(sim.reg[0x10] == 0x20);
+
+  // биты, недоступные для записи, не сравниваются
+  target        = next;
+  next.rxb1ctrl = 0x07;
+  next.cnf3     = 0x3D;
+  REQUIRE(MCP_OK == mcpConfigDiff(&ins, &next, NULL, &diff));
+  REQUIRE(diff.count == 0);
+
+  // а если изменяются только прерывания? режим конфигурации не нужен
+  setMode(&ins, MCP_MODE_NORMAL);
+  next.caninte = 0x1F;
+  REQUIRE(MCP_OK == mcpConfigDiff(&ins, &next, &target, &diff));
+  REQUIRE(diff.count == 1);
+  REQUIRE_FALSE(diff.configMode);
+  REQUIRE(MCP_OK == mcpConfigApply(&ins, &next, &diff));
+  REQUIRE(sim.reg[REG_CANINTE] == 0x1F);
+
+  // теневая копия: по шине читаются только TXRTSCTRL и пакетом RXB0CTRL..RXB1CTRL
+  ins.shadow = &shadow;
+  uint8_t data[30];
+  REQUIRE(MCP_OK == mcpReadInto(&ins, 0x00, data, 28));
+  REQUIRE(MCP_OK == mcpReadInto(&ins, 0x20, data, 12));
+  cycles = sim.csCycles;
+  REQUIRE(MCP_OK == mcpConfigDiff(&ins, &next, NULL, &diff));
+  REQUIRE(sim.csCycles == cycles + ((reads == 1) ? 1 : 2));
+  REQUIRE(diff.count == 0);
+}
+
+TEST_CASE("Configuration warm start")
+{
+  MCP_Sim      sim;
+  MCP_Instance ins = {};
+  MCP_Config   cfg = {};
+  bool         reprogrammed;
+  mcpSimInit(&sim);
+  mcpSimAttach(&sim, &ins);
+
+  cfg.rxm[0][0] = 0xFF;
+  cfg.rxm[0][1] = 0xE0;
+  cfg.rxf[0][0] = 0x24;
+  cfg.cnf1      = 0x00;
+  cfg.cnf2      = 0xB1;
+  cfg.cnf3      = 0x05;
+  cfg.caninte   = 0x03;
+
+  // отпечаток не зависит от битов, недоступных для записи
+  MCP_Config other = cfg;
+  other.cnf3       = 0x3D;
+  other.rxb1ctrl   = 0x07;
+  REQUIRE(mcpConfigFingerprint(&other) == mcpConfigFingerprint(&cfg));
+  other.caninte = 0x07;
+  REQUIRE(mcpConfigFingerprint(&other) != mcpConfigFingerprint(&cfg));
+
+  // после включения питания: микросхема перенастраивается
+  REQUIRE(MCP_OK == mcpConfigWarmStart(&ins, &cfg, MCP_MODE_NORMAL, 8, &reprogrammed));
+  REQUIRE(reprogrammed);
+  REQUIRE(mcpSimMode(&sim) == MCP_MODE_NORMAL);
+  REQUIRE(sim.reg[0x29] == 0xB1);
+  REQUIRE(sim.reg[REG_CANINTE] == 0x03);
+
+  // после сброса микроконтроллера: только чтение, режим не меняется
+  const uint32_t reads  = (MCP_BUFFER_SIZE > 0x72) ? 1 : 3;
+  MCP_Instance   warm   = {};
+  uint32_t       cycles = sim.csCycles;
+  mcpSimAttach(&sim, &warm);
+  REQUIRE(MCP_OK == mcpConfigWarmStart(&warm, &cfg, MCP_MODE_NORMAL, 8, &reprogrammed));
+  REQUIRE_FALSE(reprogrammed);
+  REQUIRE(sim.csCycles == cycles + reads);
+  REQUIRE(mcpSimMode(&sim) == MCP_MODE_NORMAL);
+
+  // а если отличаются только прерывания? одна запись без смены режима, а
+  // прочитанные регистры повторно не читаются
+  sim.reg[REG_CANINTE] = 0x00;
+  cycles               = sim.csCycles;
+  REQUIRE(MCP_OK == mcpConfigWarmStart(&warm, &cfg, MCP_MODE_NORMAL, 8, &reprogrammed));
+  REQUIRE(reprogrammed);
+  REQUIRE(sim.csCycles == cycles + reads + 1);
+  REQUIRE(sim.reg[REG_CANINTE] == 0x03);
+  REQUIRE(mcpSimMode(&sim) == MCP_MODE_NORMAL);
+
+  // а если отличается битовая синхронизация? смена режима (BIT MODIFY и
+  // чтение CANSTAT), одна запись и обратная смена режима
+  sim.reg[0x29] = 0x90;
+  cycles        = sim.csCycles;
+  REQUIRE(MCP_OK == mcpConfigWarmStart(&warm, &cfg, MCP_MODE_NORMAL, 8, &reprogrammed));
+  REQUIRE(reprogrammed);
+  REQUIRE(sim.csCycles == cycles + reads + 5);
+  REQUIRE(sim.reg[0x29] == 0xB1);
+  REQUIRE(mcpSimMode(&sim) == MCP_MODE_NORMAL);
+
+  // а если отличается только режим? регистры не записываются
+  setMode(&warm, MCP_MODE_LOOPBACK);
+  REQUIRE(MCP_OK == mcpConfigWarmStart(&warm, &cfg, MCP_MODE_NORMAL, 8, &reprogrammed));
+  REQUIRE_FALSE(reprogrammed);
+  REQUIRE(mcpSimMode(&sim) == MCP_MODE_NORMAL);
+
+  // а если чтений CANSTAT не задано? ожидание смены режима невозможно
+  cycles = sim.csCycles;
+  REQUIRE(MCP_ERROR == mcpConfigWarmStart(&warm, &cfg, MCP_MODE_NORMAL, 0, &reprogrammed));
+  REQUIRE(sim.csCycles == cycles);
+
+  // а если ошибка транспорта? код ошибки возвращается
+  warm.transactionCtx = failTransaction;
+  warm.transactionv   = NULL;
+  warm.transfer       = NULL;
+  REQUIRE(MCP_ERROR == mcpConfigWarmStart(&warm, &cfg, MCP_MODE_NORMAL, 8, &reprogrammed));
+}
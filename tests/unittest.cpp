@@ -1,5 +1,6 @@
 #include "catch/catch.hpp"
 #include "../libmcp2515/driver_mcp2515.h"
+#include "../libmcp2515/driver_mcp2515.hpp"
 #include "string.h"
 
 static uint8_t BufferTx[MCP_BUFFER_SIZE];
@@ -24,16 +25,95 @@ static int32_t transaction(uint8_t* data, uint8_t len)
   return TransactionError;
 }
 
+// Потоковый вариант транзакции: последовательные вызовы в пределах одного
+// выбора CS продолжают обмен с того места, где остановился предыдущий
+static uint32_t StreamPos;
+static uint32_t StreamCalls;
+
+static int32_t streamTransaction(uint8_t* data, uint8_t len)
+{
+  memcpy(&BufferTx[StreamPos], data, len);
+  memcpy(data, &BufferRx[StreamPos], len);
+  StreamPos += len;
+  StreamCalls++;
+  return TransactionError;
+}
+
+// Журнал транзакций: все переданные байты подряд и длины каждой транзакции
+static uint8_t  LogTx[1024];
+static uint32_t LogPos;
+static uint8_t  LogLen[16];
+static uint32_t LogCount;
+
+static int32_t logTransaction(uint8_t* data, uint8_t len)
+{
+  memcpy(&LogTx[LogPos], data, len);
+  memset(data, 0, len);
+  LogPos += len;
+  LogLen[LogCount++ & 0x0F] = len;
+  return TransactionError;
+}
+
+// Векторный вариант транзакции: сегменты записываются в журнал транзакций
+static const uint8_t* VectorTx[4];
+static uint8_t        VectorLen[4];
+static uint32_t       VectorCount;
+
+static int32_t vectorTransaction(void* ctx, const MCP_Segment* seg, uint8_t count)
+{
+  (void) ctx;
+  VectorCount = count;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    VectorTx[i & 3]  = seg[i].tx;
+    VectorLen[i & 3] = seg[i].len;
+    if (seg[i].tx)
+      memcpy(&LogTx[LogPos], seg[i].tx, seg[i].len);
+    else
+      memset(&LogTx[LogPos], 0, seg[i].len);
+    if (seg[i].rx)
+      memset(seg[i].rx, 0, seg[i].len);
+    LogPos += seg[i].len;
+  }
+  LogLen[LogCount++ & 0x0F] = (uint8_t) LogPos;
+  return TransactionError;
+}
+
+// Полнодуплексный вариант обмена: принимаемые данные берутся из BufferRx подряд
+static uint8_t* DuplexRx[4];
+static uint32_t DuplexCount;
+
+static int32_t duplexTransfer(void* ctx, const uint8_t* tx, uint8_t* rx, uint8_t len)
+{
+  (void) ctx;
+  if (tx)
+    memcpy(&LogTx[LogPos], tx, len);
+  else
+    memset(&LogTx[LogPos], 0, len);
+  if (rx)
+    memcpy(rx, &BufferRx[StreamPos], len);
+  LogPos += len;
+  StreamPos += len;
+  DuplexRx[DuplexCount++ & 3] = rx;
+  return TransactionError;
+}
+
 void resetState()
 {
-  SelectPtr = 0;
+  DuplexCount = 0;
+  VectorCount = 0;
+  LogPos      = 0;
+  LogCount    = 0;
+  StreamPos   = 0;
+  StreamCalls = 0;
+  SelectPtr   = 0;
   memset(&SelectState[0], 0, sizeof(SelectState));
   memset(&BufferTx[0], 0, sizeof(BufferTx));
 }
 
 TEST_CASE("Read registers")
 {
-  MCP_Instance ins;
+  MCP_Instance ins = {};
   uint8_t      addr;
   uint8_t      len;
   uint8_t*     data;
@@ -71,7 +151,7 @@ TEST_CASE("Read registers")
 
   // а если длина впритык размеру буфера?
   addr = 0x00;
-  len  = 30;
+  len  = MCP_BUFFER_SIZE - 2;
   resetState();
   memset(&ins.buffer[0], 0, MCP_BUFFER_SIZE);
   TransactionError = MCP_OK;
@@ -85,7 +165,7 @@ TEST_CASE("Read registers")
 
   // а если длина не влезает в буфер?
   addr = 0x00;
-  len  = 31;
+  len  = MCP_BUFFER_SIZE - 1;
   resetState();
   memset(&ins.buffer[0], 0, MCP_BUFFER_SIZE);
   TransactionError = MCP_OK;
@@ -112,7 +192,7 @@ TEST_CASE("Read registers")
 
 TEST_CASE("Read rx buffer")
 {
-  MCP_Instance        ins;
+  MCP_Instance        ins = {};
   MCPReadRxBufferType type;
   uint8_t*            data;
   uint8_t             len;
@@ -186,11 +266,220 @@ TEST_CASE("Read rx buffer")
   REQUIRE(0 == memcmp(&BufferTx[1], &data[0], len));
 }
 
+TEST_CASE("Receive frame")
+{
+  MCP_Instance ins = {};
+  MCP_Frame    frame;
+
+  ins.chipSelect  = chipSelect;
+  ins.transaction = transaction;
+
+  // стандартный фрейм из буфера 0
+  const uint8_t std[14] = {0x00, 0x24, 0x60, 0xAA, 0xBB, 0x03, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88};
+  resetState();
+  memcpy(&BufferRx[0], std, sizeof(std));
+  memset(&frame, 0, sizeof(frame));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &frame));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+  REQUIRE(BufferTx[0] == MCP_READRXBUFFER_RXB0SIDH);
+  REQUIRE(frame.id == 0x123);
+  REQUIRE(frame.flags == 0);
+  REQUIRE(frame.dlc == 3);
+  REQUIRE(frame.data[0] == 0x11);
+  REQUIRE(frame.data[1] == 0x22);
+  REQUIRE(frame.data[2] == 0x33);
+  REQUIRE(frame.data[3] == 0x00);
+
+  // стандартный удаленный запрос из буфера 1
+  const uint8_t stdRtr[14] = {0x00, 0xFF, 0xF0, 0x00, 0x00, 0x02};
+  resetState();
+  memcpy(&BufferRx[0], stdRtr, sizeof(stdRtr));
+  memset(&frame, 0, sizeof(frame));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 1, &frame));
+  REQUIRE(BufferTx[0] == MCP_READRXBUFFER_RXB1SIDH);
+  REQUIRE(frame.id == 0x7FF);
+  REQUIRE(frame.flags == MCP_FRAME_RTR);
+  REQUIRE(frame.dlc == 2);
+
+  // расширенный фрейм с DLC больше 8
+  const uint8_t ext[14] = {0x00, 0x0E, 0xCA, 0x56, 0x78, 0x0F, 1, 2, 3, 4, 5, 6, 7, 8};
+  resetState();
+  memcpy(&BufferRx[0], ext, sizeof(ext));
+  memset(&frame, 0, sizeof(frame));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &frame));
+  REQUIRE(frame.id == 0x1DA5678);
+  REQUIRE(frame.flags == MCP_FRAME_IDE);
+  REQUIRE(frame.dlc == 8);
+  REQUIRE(0 == memcmp(&frame.data[0], &ext[6], 8));
+
+  // расширенный удаленный запрос
+  const uint8_t extRtr[14] = {0x00, 0x00, 0x08, 0x00, 0x01, 0x40};
+  resetState();
+  memcpy(&BufferRx[0], extRtr, sizeof(extRtr));
+  memset(&frame, 0, sizeof(frame));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &frame));
+  REQUIRE(frame.id == 0x1);
+  REQUIRE(frame.flags == (MCP_FRAME_IDE | MCP_FRAME_RTR));
+  REQUIRE(frame.dlc == 0);
+
+  // а если номер буфера неверный?
+  resetState();
+  REQUIRE(MCP_ERROR == mcpReceiveFrame(&ins, 2, &frame));
+  REQUIRE(SelectState[0] == false);
+  REQUIRE(SelectState[1] == false);
+
+  // а если в транзакции ошибка?
+  resetState();
+  memcpy(&BufferRx[0], std, sizeof(std));
+  memset(&frame, 0, sizeof(frame));
+  TransactionError = MCP_ERROR;
+  REQUIRE(MCP_ERROR == mcpReceiveFrame(&ins, 0, &frame));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+  REQUIRE(frame.id == 0);
+  REQUIRE(frame.dlc == 0);
+
+  memset(&BufferRx[0], 0, sizeof(BufferRx));
+}
+
+TEST_CASE("Receive frame two-phase")
+{
+  MCP_Instance ins = {};
+  MCP_Frame    frame;
+
+  ins.chipSelect  = chipSelect;
+  ins.transaction = streamTransaction;
+  ins.flags       = MCP_FLAG_RX_TWOPHASE;
+
+  // фрейм с тремя байтами данных: заголовок и 3 байта за один выбор CS
+  const uint8_t std[14] = {0x00, 0x24, 0x60, 0xAA, 0xBB, 0x03, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88};
+  resetState();
+  memcpy(&BufferRx[0], std, sizeof(std));
+  memset(&frame, 0, sizeof(frame));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 1, &frame));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+  REQUIRE(SelectState[2] == false);
+  REQUIRE(StreamCalls == 2);
+  REQUIRE(StreamPos == 1 + 5 + 3);
+  REQUIRE(BufferTx[0] == MCP_READRXBUFFER_RXB1SIDH);
+  REQUIRE(frame.id == 0x123);
+  REQUIRE(frame.dlc == 3);
+  REQUIRE(frame.data[0] == 0x11);
+  REQUIRE(frame.data[1] == 0x22);
+  REQUIRE(frame.data[2] == 0x33);
+  REQUIRE(frame.data[3] == 0x00);
+
+  // фрейм без данных читается одной транзакцией
+  const uint8_t empty[14] = {0x00, 0x24, 0x60, 0x00, 0x00, 0x00, 0x11};
+  resetState();
+  memcpy(&BufferRx[0], empty, sizeof(empty));
+  memset(&frame, 0, sizeof(frame));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &frame));
+  REQUIRE(StreamCalls == 1);
+  REQUIRE(StreamPos == 1 + 5);
+  REQUIRE(frame.id == 0x123);
+  REQUIRE(frame.dlc == 0);
+
+  // удаленный запрос данных не читает, несмотря на DLC
+  const uint8_t extRtr[14] = {0x00, 0x00, 0x08, 0x00, 0x01, 0x48};
+  resetState();
+  memcpy(&BufferRx[0], extRtr, sizeof(extRtr));
+  memset(&frame, 0, sizeof(frame));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &frame));
+  REQUIRE(StreamCalls == 1);
+  REQUIRE(frame.flags == (MCP_FRAME_IDE | MCP_FRAME_RTR));
+  REQUIRE(frame.dlc == 8);
+
+  // DLC больше 8 ограничивает чтение восемью байтами
+  const uint8_t big[14] = {0x00, 0x24, 0x60, 0x00, 0x00, 0x0F, 1, 2, 3, 4, 5, 6, 7, 8};
+  resetState();
+  memcpy(&BufferRx[0], big, sizeof(big));
+  memset(&frame, 0, sizeof(frame));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &frame));
+  REQUIRE(StreamCalls == 2);
+  REQUIRE(StreamPos == 1 + 13);
+  REQUIRE(0 == memcmp(&frame.data[0], &big[6], 8));
+
+  // а если в транзакции заголовка ошибка?
+  resetState();
+  memcpy(&BufferRx[0], std, sizeof(std));
+  memset(&frame, 0, sizeof(frame));
+  TransactionError = MCP_ERROR;
+  REQUIRE(MCP_ERROR == mcpReceiveFrame(&ins, 0, &frame));
+  REQUIRE(StreamCalls == 1);
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+  REQUIRE(frame.id == 0);
+
+  memset(&BufferRx[0], 0, sizeof(BufferRx));
+}
+
+TEST_CASE("Receive both frames")
+{
+  MCP_Instance ins = {};
+  MCP_Frame    frames[2];
+
+  ins.chipSelect  = chipSelect;
+  ins.transaction = transaction;
+
+  // чтение обоих буферов одной командой READ и сброс обоих флагов
+  const uint8_t rxb0[13] = {0x24, 0x60, 0x00, 0x00, 0x02, 0x11, 0x22};
+  const uint8_t rxb1[13] = {0x0E, 0xCA, 0x56, 0x78, 0x08, 1, 2, 3, 4, 5, 6, 7, 8};
+  resetState();
+  memset(&BufferRx[0], 0, sizeof(BufferRx));
+  memcpy(&BufferRx[2], rxb0, sizeof(rxb0));
+  memcpy(&BufferRx[2 + 16], rxb1, sizeof(rxb1));
+  memset(&frames[0], 0, sizeof(frames));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReceiveBothFrames(&ins, frames));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+  REQUIRE(SelectState[2] == true);
+  REQUIRE(SelectState[3] == false);
+  REQUIRE(frames[0].id == 0x123);
+  REQUIRE(frames[0].flags == 0);
+  REQUIRE(frames[0].dlc == 2);
+  REQUIRE(frames[0].data[0] == 0x11);
+  REQUIRE(frames[0].data[1] == 0x22);
+  REQUIRE(frames[1].id == 0x1DA5678);
+  REQUIRE(frames[1].flags == MCP_FRAME_IDE);
+  REQUIRE(frames[1].dlc == 8);
+  REQUIRE(0 == memcmp(&frames[1].data[0], &rxb1[5], 8));
+  REQUIRE(BufferTx[0] == 0x05);
+  REQUIRE(BufferTx[1] == MCP_REG_CANINTF);
+  REQUIRE(BufferTx[2] == (MCP_CANINTF_RX0IF | MCP_CANINTF_RX1IF));
+  REQUIRE(BufferTx[3] == 0x00);
+
+  // а если в транзакции чтения ошибка?
+  resetState();
+  memset(&frames[0], 0, sizeof(frames));
+  TransactionError = MCP_ERROR;
+  REQUIRE(MCP_ERROR == mcpReceiveBothFrames(&ins, frames));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+  REQUIRE(SelectState[2] == false);
+  REQUIRE(BufferTx[0] == 0x03);
+  REQUIRE(BufferTx[1] == MCP_REG_RXB0SIDH);
+  REQUIRE(frames[0].id == 0);
+
+  memset(&BufferRx[0], 0, sizeof(BufferRx));
+}
+
 TEST_CASE("Write registers")
 {
-  MCP_Instance ins;
+  MCP_Instance ins = {};
   uint8_t      addr;
-  uint8_t      data[40];
+  uint8_t      data[MCP_BUFFER_SIZE + 8];
   uint8_t      len;
 
   ins.chipSelect  = chipSelect;
@@ -229,7 +518,7 @@ TEST_CASE("Write registers")
 
   // а если длина впритык размеру буфера?
   addr = 0x00;
-  len  = 30;
+  len  = MCP_BUFFER_SIZE - 2;
   resetState();
   memset(&ins.buffer[0], 0, MCP_BUFFER_SIZE);
   TransactionError = MCP_OK;
@@ -243,7 +532,7 @@ TEST_CASE("Write registers")
 
   // а если длина не влезает в буфер?
   addr = 0x00;
-  len  = 31;
+  len  = MCP_BUFFER_SIZE - 1;
   resetState();
   memset(&ins.buffer[0], 0, MCP_BUFFER_SIZE);
   TransactionError = MCP_OK;
@@ -269,11 +558,67 @@ TEST_CASE("Write registers")
   REQUIRE(0 == memcmp(&BufferTx[2 + len], &BufferNULL[0], sizeof(BufferTx) - len - 2));
 }
 
+TEST_CASE("Write filters")
+{
+  MCP_Instance ins = {};
+  MCP_Filters  filters;
+  uint8_t      image[0x28];
+
+  ins.chipSelect  = chipSelect;
+  ins.transaction = logTransaction;
+
+  for (uint8_t i = 0; i < 6; i++)
+    for (uint8_t j = 0; j < 4; j++)
+      filters.rxf[i][j] = (uint8_t) (0x10 * i + j + 1);
+  for (uint8_t i = 0; i < 2; i++)
+    for (uint8_t j = 0; j < 4; j++)
+      filters.rxm[i][j] = (uint8_t) (0xA0 + 0x10 * i + j);
+
+  // собираем записанный образ регистров из журнала транзакций
+  resetState();
+  memset(&image[0], 0xFF, sizeof(image));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpWriteFilters(&ins, &filters));
+  uint32_t pos = 0;
+  for (uint32_t i = 0; i < LogCount; i++)
+  {
+    REQUIRE(LogTx[pos] == 0x02);
+    REQUIRE(LogLen[i] <= MCP_BUFFER_SIZE);
+    memcpy(&image[LogTx[pos + 1]], &LogTx[pos + 2], LogLen[i] - 2U);
+    pos += LogLen[i];
+  }
+  REQUIRE(pos == LogPos);
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    REQUIRE(0 == memcmp(&image[i * 4], &filters.rxf[i][0], 4));
+    REQUIRE(0 == memcmp(&image[0x10 + i * 4], &filters.rxf[i + 3][0], 4));
+  }
+  REQUIRE(0 == memcmp(&image[0x20], &filters.rxm[0][0], 8));
+
+  // 0x00..0x0B, 0x10..0x1B и 0x20..0x27: служебные регистры 0x0C..0x0F и
+  // 0x1C..0x1F (в том числе CANCTRL) не записываются
+  REQUIRE(LogCount == 3);
+  REQUIRE(LogLen[0] == 2 + 12);
+  REQUIRE(LogLen[1] == 2 + 12);
+  REQUIRE(LogLen[2] == 2 + 8);
+  for (uint8_t i = 0x0C; i < 0x10; i++)
+  {
+    REQUIRE(image[i] == 0xFF);
+    REQUIRE(image[i + 0x10] == 0xFF);
+  }
+
+  // а если в транзакции ошибка?
+  resetState();
+  TransactionError = MCP_ERROR;
+  REQUIRE(MCP_ERROR == mcpWriteFilters(&ins, &filters));
+  REQUIRE(LogCount == 1);
+}
+
 TEST_CASE("Load tx buffer")
 {
-  MCP_Instance        ins;
+  MCP_Instance        ins = {};
   MCPLoadTxBufferType type;
-  uint8_t             data[40];
+  uint8_t             data[MCP_BUFFER_SIZE + 8];
 
   ins.chipSelect  = chipSelect;
   ins.transaction = transaction;
@@ -342,9 +687,79 @@ TEST_CASE("Load tx buffer")
   REQUIRE(0 == memcmp(&BufferTx[1 + 8], &BufferNULL[0], sizeof(BufferTx) - 8 - 1));
 }
 
+TEST_CASE("Load tx frame")
+{
+  MCP_Instance ins = {};
+  MCP_Frame    frame;
+  uint8_t      saved;
+
+  ins.chipSelect  = chipSelect;
+  ins.transaction = transaction;
+
+  // стандартный фрейм с двумя байтами данных в буфер 0
+  frame.id      = 0x123;
+  frame.flags   = 0;
+  frame.dlc     = 2;
+  frame.data[0] = 0x11;
+  frame.data[1] = 0x22;
+  frame.data[2] = 0x33;
+  resetState();
+  memset(&ins.buffer[0], 0, MCP_BUFFER_SIZE);
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 0, &frame, &saved));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+  const uint8_t std[8] = {MCP_LOADTXBUFFER_TXB0SIDH, 0x24, 0x60, 0x00, 0x00, 0x02, 0x11, 0x22};
+  REQUIRE(0 == memcmp(&BufferTx[0], std, sizeof(std)));
+  REQUIRE(0 == memcmp(&BufferTx[sizeof(std)], &BufferNULL[0], sizeof(BufferTx) - sizeof(std)));
+  REQUIRE(saved == 6);
+
+  // расширенный фрейм с DLC больше 8 в буфер 2
+  frame.id    = 0x1DA5678;
+  frame.flags = MCP_FRAME_IDE;
+  frame.dlc   = 15;
+  for (uint8_t i = 0; i < 8; i++)
+    frame.data[i] = (uint8_t) (i + 1);
+  resetState();
+  memset(&ins.buffer[0], 0, MCP_BUFFER_SIZE);
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 2, &frame, &saved));
+  const uint8_t ext[14] = {MCP_LOADTXBUFFER_TXB2SIDH, 0x0E, 0xCA, 0x56, 0x78, 0x08, 1, 2, 3, 4, 5, 6, 7, 8};
+  REQUIRE(0 == memcmp(&BufferTx[0], ext, sizeof(ext)));
+  REQUIRE(0 == memcmp(&BufferTx[sizeof(ext)], &BufferNULL[0], sizeof(BufferTx) - sizeof(ext)));
+  REQUIRE(saved == 0);
+
+  // удаленный запрос передается без данных
+  frame.id    = 0x7FF;
+  frame.flags = MCP_FRAME_RTR;
+  frame.dlc   = 4;
+  resetState();
+  memset(&ins.buffer[0], 0, MCP_BUFFER_SIZE);
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 1, &frame, NULL));
+  const uint8_t rtr[6] = {MCP_LOADTXBUFFER_TXB1SIDH, 0xFF, 0xE0, 0x00, 0x00, 0x44};
+  REQUIRE(0 == memcmp(&BufferTx[0], rtr, sizeof(rtr)));
+  REQUIRE(0 == memcmp(&BufferTx[sizeof(rtr)], &BufferNULL[0], sizeof(BufferTx) - sizeof(rtr)));
+
+  // а если номер буфера неверный?
+  resetState();
+  REQUIRE(MCP_ERROR == mcpLoadTxFrame(&ins, 3, &frame, &saved));
+  REQUIRE(SelectState[0] == false);
+  REQUIRE(SelectState[1] == false);
+
+  // а если была ошибка в транзакции?
+  resetState();
+  memset(&ins.buffer[0], 0, MCP_BUFFER_SIZE);
+  TransactionError = MCP_ERROR;
+  REQUIRE(MCP_ERROR == mcpLoadTxFrame(&ins, 1, &frame, &saved));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+  REQUIRE(0 == memcmp(&BufferTx[0], rtr, sizeof(rtr)));
+}
+
 TEST_CASE("Bit modify")
 {
-  MCP_Instance ins;
+  MCP_Instance ins = {};
   uint8_t      addr;
   uint8_t      mask;
   uint8_t      data;
@@ -387,7 +802,7 @@ TEST_CASE("Bit modify")
 
 TEST_CASE("RTS")
 {
-  MCP_Instance ins;
+  MCP_Instance ins = {};
   uint8_t      cmd;
 
   ins.chipSelect  = chipSelect;
@@ -449,9 +864,78 @@ TEST_CASE("RTS")
   REQUIRE(0 == memcmp(&BufferTx[1], &BufferNULL[0], sizeof(BufferTx) - 1));
 }
 
+TEST_CASE("Reset")
+{
+  MCP_Instance ins    = {};
+  MCP_Shadow   shadow = {};
+
+  ins.chipSelect  = chipSelect;
+  ins.transaction = transaction;
+  ins.shadow      = &shadow;
+
+  // просто сброс: одна команда, теневая копия сбрасывается
+  memset(&shadow.valid[0], 0xFF, sizeof(shadow.valid));
+  resetState();
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReset(&ins));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+  REQUIRE(BufferTx[0] == 0xC0);
+  REQUIRE(0 == memcmp(&BufferTx[1], &BufferNULL[0], sizeof(BufferTx) - 1));
+  for (uint8_t i = 0; i < sizeof(shadow.valid); i++)
+    REQUIRE(shadow.valid[i] == 0);
+
+  // а если ошибка в транзакции?
+  resetState();
+  TransactionError = MCP_ERROR;
+  REQUIRE(MCP_ERROR == mcpReset(&ins));
+  REQUIRE(BufferTx[0] == 0xC0);
+  TransactionError = MCP_OK;
+}
+
+TEST_CASE("Set mode")
+{
+  MCP_Instance ins = {};
+
+  ins.chipSelect  = chipSelect;
+  ins.transaction = logTransaction;
+
+  // журнал возвращает нули: CANSTAT сообщает нормальный режим
+  resetState();
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpSetMode(&ins, MCP_MODE_NORMAL, 4));
+  REQUIRE(LogCount == 2);
+  const uint8_t normal[] = {0x05, 0x0F, 0xE0, 0x00, 0x03, 0x0E, 0x00};
+  REQUIRE(0 == memcmp(&LogTx[0], normal, sizeof(normal)));
+
+  // а если режим не устанавливается? не более polls чтений
+  resetState();
+  REQUIRE(MCP_ERROR == mcpSetMode(&ins, MCP_MODE_CONFIG, 3));
+  REQUIRE(LogCount == 4);
+  REQUIRE(LogTx[3] == 0x80);
+
+  // а если polls = 0? только запрос
+  resetState();
+  REQUIRE(MCP_OK == mcpSetMode(&ins, MCP_MODE_LOOPBACK, 0));
+  REQUIRE(LogCount == 1);
+  REQUIRE(LogTx[3] == 0x40);
+
+  // а если режим недопустим? обращения к шине нет
+  resetState();
+  REQUIRE(MCP_ERROR == mcpSetMode(&ins, 5, 1));
+  REQUIRE(LogCount == 0);
+
+  // а если ошибка в транзакции?
+  resetState();
+  TransactionError = MCP_ERROR;
+  REQUIRE(MCP_ERROR == mcpSetMode(&ins, MCP_MODE_NORMAL, 4));
+  REQUIRE(LogCount == 1);
+  TransactionError = MCP_OK;
+}
+
 TEST_CASE("Read status")
 {
-  MCP_Instance ins;
+  MCP_Instance ins = {};
 
   ins.chipSelect  = chipSelect;
   ins.transaction = transaction;
@@ -475,11 +959,18 @@ TEST_CASE("Read status")
   REQUIRE(SelectState[1] == false);
   REQUIRE(BufferTx[0] == 0xA0);
   REQUIRE(0 == memcmp(&BufferTx[1], &BufferNULL[0], sizeof(BufferTx) - 1));
+
+  // а если статус не нулевой? возвращается байт статуса
+  resetState();
+  BufferRx[1]      = 0x5A;
+  TransactionError = MCP_OK;
+  REQUIRE(0x5A == mcpReadStatus(&ins));
+  BufferRx[1] = 0;
 }
 
 TEST_CASE("Rx status")
 {
-  MCP_Instance ins;
+  MCP_Instance ins = {};
 
   ins.chipSelect  = chipSelect;
   ins.transaction = transaction;
@@ -503,4 +994,675 @@ TEST_CASE("Rx status")
   REQUIRE(SelectState[1] == false);
   REQUIRE(BufferTx[0] == 0xB0);
   REQUIRE(0 == memcmp(&BufferTx[1], &BufferNULL[0], sizeof(BufferTx) - 1));
+
+  // а если статус не нулевой? возвращается байт статуса
+  resetState();
+  BufferRx[1]      = 0x5A;
+  TransactionError = MCP_OK;
+  REQUIRE(0x5A == mcpRxStatus(&ins));
+  BufferRx[1] = 0;
+}
+
+TEST_CASE("Status into")
+{
+  MCP_Instance ins = {};
+  uint8_t      status;
+  uint8_t      repeat;
+
+  ins.transaction = logTransaction;
+  ins.chipSelect  = chipSelect;
+
+  // команда и байт статуса - одна транзакция из двух байт
+  LogPos   = 0;
+  LogCount = 0;
+  memset(&ins.buffer[0], 0xFF, MCP_BUFFER_SIZE);
+  TransactionError = MCP_OK;
+  status           = 0xEE;
+  REQUIRE(MCP_OK == mcpReadStatusInto(&ins, &status, NULL));
+  REQUIRE(LogCount == 1);
+  REQUIRE(LogLen[0] == 2);
+  REQUIRE(LogTx[0] == 0xA0);
+  REQUIRE(LogTx[1] == 0x00);
+  REQUIRE(status == 0x00);
+
+  // с повтором байта статуса - три байта
+  REQUIRE(MCP_OK == mcpRxStatusInto(&ins, &status, &repeat));
+  REQUIRE(LogCount == 2);
+  REQUIRE(LogLen[1] == 3);
+  REQUIRE(LogTx[2] == 0xB0);
+
+  // статус из ответа микросхемы
+  ins.transaction = transaction;
+  resetState();
+  BufferRx[1] = MCP_STATUS_RX1IF | MCP_STATUS_TX0REQ;
+  BufferRx[2] = MCP_STATUS_RX1IF | MCP_STATUS_TX0REQ;
+  REQUIRE(MCP_OK == mcpReadStatusInto(&ins, &status, &repeat));
+  REQUIRE(status == (MCP_STATUS_RX1IF | MCP_STATUS_TX0REQ));
+  REQUIRE(repeat == status);
+  REQUIRE(BufferTx[0] == 0xA0);
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+
+  // а если ошибка в транзакции? статус не изменяется
+  resetState();
+  TransactionError = MCP_ERROR;
+  status           = 0x5A;
+  REQUIRE(MCP_ERROR == mcpRxStatusInto(&ins, &status, NULL));
+  REQUIRE(status == 0x5A);
+  TransactionError = MCP_OK;
+  memset(&BufferRx[0], 0, sizeof(BufferRx));
+}
+
+TEST_CASE("Vectored transaction")
+{
+  MCP_Instance ins = {};
+  uint8_t      data[200];
+  MCP_Frame    frame;
+
+  ins.chipSelect   = chipSelect;
+  ins.transaction  = transaction;
+  ins.transactionv = vectorTransaction;
+
+  for (uint8_t i = 0; i < (uint8_t) sizeof(data); i++)
+    data[i] = i;
+
+  // запись регистров: полезная нагрузка передается прямо из памяти пользователя
+  resetState();
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpWrite(&ins, 0x30, data, 5));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+  REQUIRE(VectorCount == 2);
+  REQUIRE(VectorTx[0] == &ins.buffer[0]);
+  REQUIRE(VectorLen[0] == 2);
+  REQUIRE(VectorTx[1] == &data[0]);
+  REQUIRE(VectorLen[1] == 5);
+  REQUIRE(LogTx[0] == 0x02);
+  REQUIRE(LogTx[1] == 0x30);
+  REQUIRE(0 == memcmp(&LogTx[2], data, 5));
+
+  // длина записи не ограничена размером буфера
+  resetState();
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpWrite(&ins, 0x00, data, sizeof(data)));
+  REQUIRE(VectorLen[1] == sizeof(data));
+  REQUIRE(LogPos == 2 + sizeof(data));
+
+  // запись без данных передает только заголовок
+  resetState();
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpWrite(&ins, 0x00, data, 0));
+  REQUIRE(VectorCount == 1);
+
+  // загрузка передающего буфера
+  resetState();
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpLoadTxBuffer(&ins, MCP_LOADTXBUFFER_TXB1SIDH, data));
+  REQUIRE(VectorCount == 2);
+  REQUIRE(VectorTx[1] == &data[0]);
+  REQUIRE(VectorLen[1] == 13);
+  REQUIRE(LogTx[0] == MCP_LOADTXBUFFER_TXB1SIDH);
+  REQUIRE(0 == memcmp(&LogTx[1], data, 13));
+
+  // загрузка фрейма: данные фрейма передаются без копирования
+  frame.id    = 0x123;
+  frame.flags = 0;
+  frame.dlc   = 2;
+  memcpy(&frame.data[0], data, 8);
+  resetState();
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 2, &frame, NULL));
+  REQUIRE(VectorCount == 2);
+  REQUIRE(VectorLen[0] == 6);
+  REQUIRE(VectorTx[1] == &frame.data[0]);
+  REQUIRE(VectorLen[1] == 2);
+  const uint8_t std[8] = {MCP_LOADTXBUFFER_TXB2SIDH, 0x24, 0x60, 0x00, 0x00, 0x02, 0x00, 0x01};
+  REQUIRE(0 == memcmp(&LogTx[0], std, sizeof(std)));
+
+  // удаленный запрос передается одним сегментом
+  frame.flags = MCP_FRAME_RTR;
+  resetState();
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 0, &frame, NULL));
+  REQUIRE(VectorCount == 1);
+  REQUIRE(VectorLen[0] == 6);
+
+  // фильтры записываются тремя транзакциями в обход служебных регистров
+  MCP_Filters filters;
+  memset(&filters, 0, sizeof(filters));
+  resetState();
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpWriteFilters(&ins, &filters));
+  REQUIRE(LogCount == 3);
+  REQUIRE(LogPos == 3 * 2 + 0x20);
+
+  // а если в транзакции ошибка?
+  resetState();
+  TransactionError = MCP_ERROR;
+  REQUIRE(MCP_ERROR == mcpWrite(&ins, 0x30, data, 5));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+}
+
+TEST_CASE("Full-duplex transfer")
+{
+  MCP_Instance ins = {};
+  uint8_t      data[16];
+  uint8_t      len;
+
+  ins.chipSelect  = chipSelect;
+  ins.transaction = transaction;
+  ins.transfer    = duplexTransfer;
+
+  for (uint8_t i = 0; i < (uint8_t) sizeof(BufferRx); i++)
+    BufferRx[i] = (uint8_t) (0x80 + i);
+
+  // чтение регистров: данные принимаются сразу в память пользователя
+  resetState();
+  memset(&data[0], 0, sizeof(data));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReadInto(&ins, 0x2C, data, 3));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+  REQUIRE(DuplexCount == 2);
+  REQUIRE(DuplexRx[0] == NULL);
+  REQUIRE(DuplexRx[1] == &data[0]);
+  REQUIRE(LogPos == 2 + 3);
+  REQUIRE(LogTx[0] == 0x03);
+  REQUIRE(LogTx[1] == 0x2C);
+  REQUIRE(0 == memcmp(&LogTx[2], &BufferNULL[0], 3));
+  REQUIRE(0 == memcmp(&data[0], &BufferRx[2], 3));
+  REQUIRE(data[3] == 0);
+
+  // чтение приемного буфера
+  resetState();
+  memset(&data[0], 0, sizeof(data));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReadRxBufferInto(&ins, MCP_READRXBUFFER_RXB1SIDH, data, &len));
+  REQUIRE(len == 13);
+  REQUIRE(DuplexRx[1] == &data[0]);
+  REQUIRE(LogTx[0] == MCP_READRXBUFFER_RXB1SIDH);
+  REQUIRE(0 == memcmp(&data[0], &BufferRx[1], 13));
+
+  resetState();
+  memset(&data[0], 0, sizeof(data));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReadRxBufferInto(&ins, MCP_READRXBUFFER_RXB0D0, data, &len));
+  REQUIRE(len == 8);
+  REQUIRE(0 == memcmp(&data[0], &BufferRx[1], 8));
+
+  // запись регистров: заголовок и данные за один выбор CS
+  resetState();
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpWrite(&ins, 0x30, data, 4));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+  REQUIRE(DuplexCount == 2);
+  REQUIRE(LogTx[0] == 0x02);
+  REQUIRE(LogTx[1] == 0x30);
+  REQUIRE(0 == memcmp(&LogTx[2], data, 4));
+
+  // без полнодуплексного транспорта данные копируются из buffer
+  ins.transfer = NULL;
+  resetState();
+  memset(&data[0], 0, sizeof(data));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReadInto(&ins, 0x2C, data, 3));
+  REQUIRE(BufferTx[0] == 0x03);
+  REQUIRE(BufferTx[1] == 0x2C);
+  REQUIRE(0 == memcmp(&data[0], &BufferRx[2], 3));
+
+  resetState();
+  memset(&data[0], 0, sizeof(data));
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpReadRxBufferInto(&ins, MCP_READRXBUFFER_RXB0SIDH, data, &len));
+  REQUIRE(len == 13);
+  REQUIRE(0 == memcmp(&data[0], &BufferRx[1], 13));
+
+  resetState();
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_ERROR_BUFFER == mcpReadInto(&ins, 0x00, data, MCP_BUFFER_SIZE - 1));
+
+  // а если в транзакции ошибка?
+  ins.transfer = duplexTransfer;
+  resetState();
+  memset(&data[0], 0, sizeof(data));
+  TransactionError = MCP_ERROR;
+  REQUIRE(MCP_ERROR == mcpReadInto(&ins, 0x2C, data, 3));
+  REQUIRE(DuplexCount == 1);
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+
+  memset(&BufferRx[0], 0, sizeof(BufferRx));
+}
+
+// Общая реализация транспорта для нескольких микросхем: состояние каждой
+// микросхемы передается через ctx
+struct FakeChip
+{
+  bool     selected;
+  uint32_t selects;
+  uint8_t  lastTx[4];
+  uint8_t  status;
+};
+
+static void chipSelectCtx(void* ctx, bool select)
+{
+  FakeChip* chip = static_cast<FakeChip*>(ctx);
+  chip->selected = select;
+  chip->selects++;
+}
+
+static int32_t transactionCtx(void* ctx, uint8_t* data, uint8_t len)
+{
+  FakeChip* chip = static_cast<FakeChip*>(ctx);
+  if (!chip->selected)
+    return MCP_ERROR;
+  memcpy(&chip->lastTx[0], data, len < 4 ? len : 4);
+  memset(data, chip->status, len);
+  return MCP_OK;
+}
+
+TEST_CASE("User context")
+{
+  FakeChip     chips[2] = {};
+  MCP_Instance ins[2]   = {};
+
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    ins[i].ctx            = &chips[i];
+    ins[i].chipSelectCtx  = chipSelectCtx;
+    ins[i].transactionCtx = transactionCtx;
+    chips[i].status       = (uint8_t) (0x10 + i);
+  }
+
+  // каждая микросхема получает только свои транзакции
+  REQUIRE(MCP_OK == mcpBitModify(&ins[0], 0x2B, 0x03, 0x01));
+  REQUIRE(MCP_OK == mcpRTS(&ins[1], MCP_RTSCMD_BUFFER2));
+  REQUIRE(chips[0].selects == 2);
+  REQUIRE(chips[0].selected == false);
+  REQUIRE(chips[0].lastTx[0] == 0x05);
+  REQUIRE(chips[0].lastTx[1] == 0x2B);
+  REQUIRE(chips[1].selects == 2);
+  REQUIRE(chips[1].lastTx[0] == MCP_RTSCMD_BUFFER2);
+
+  // принимаемые данные приходят от своей микросхемы
+  uint8_t* data;
+  REQUIRE(MCP_OK == mcpRead(&ins[1], 0x2C, &data, 1));
+  REQUIRE(data[0] == 0x11);
+  REQUIRE(MCP_OK == mcpRead(&ins[0], 0x2C, &data, 1));
+  REQUIRE(data[0] == 0x10);
+
+  // функции с контекстом имеют приоритет над функциями без него
+  ins[0].chipSelect  = chipSelect;
+  ins[0].transaction = transaction;
+  resetState();
+  REQUIRE(MCP_OK == mcpRTS(&ins[0], MCP_RTSCMD_BUFFER0));
+  REQUIRE(SelectState[0] == false);
+  REQUIRE(chips[0].lastTx[0] == MCP_RTSCMD_BUFFER0);
+
+  // а если функции с контекстом не заданы? вызываются функции без контекста
+  ins[0].chipSelectCtx  = NULL;
+  ins[0].transactionCtx = NULL;
+  TransactionError      = MCP_OK;
+  REQUIRE(MCP_OK == mcpRTS(&ins[0], MCP_RTSCMD_BUFFER1));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+  REQUIRE(BufferTx[0] == MCP_RTSCMD_BUFFER1);
+  REQUIRE(chips[0].lastTx[0] == MCP_RTSCMD_BUFFER0);
+}
+
+// Счетчики вызовов транспорта
+static uint32_t CountSelect;
+static uint32_t CountTransaction;
+
+static void countSelect(void* ctx, bool select)
+{
+  (void) ctx;
+  (void) select;
+  CountSelect++;
+}
+
+static int32_t countTransaction(void* ctx, uint8_t* data, uint8_t len)
+{
+  (void) ctx;
+  memset(data, 0, len);
+  CountTransaction++;
+  return MCP_OK;
+}
+
+static int32_t countTransfer(void* ctx, const uint8_t* tx, uint8_t* rx, uint8_t len)
+{
+  (void) ctx;
+  (void) tx;
+  if (rx)
+    memset(rx, 0, len);
+  CountTransaction++;
+  return MCP_OK;
+}
+
+TEST_CASE("Transport chip select")
+{
+  MCP_Instance ins = {};
+  uint8_t*     data;
+  uint8_t      len;
+  uint8_t      raw[16] = {};
+  MCP_Frame    frame   = {};
+
+  ins.chipSelectCtx  = countSelect;
+  ins.transactionCtx = countTransaction;
+  ins.flags          = MCP_FLAG_TRANSPORT_CS | MCP_FLAG_RX_TWOPHASE;
+
+  // каждая операция - ровно один вызов транспорта, CS не переключается
+  CountSelect      = 0;
+  CountTransaction = 0;
+  REQUIRE(MCP_OK == mcpRead(&ins, 0x0F, &data, 1));
+  REQUIRE(MCP_OK == mcpReadRxBuffer(&ins, MCP_READRXBUFFER_RXB0SIDH, &data, &len));
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &frame));
+  REQUIRE(MCP_OK == mcpWrite(&ins, 0x30, raw, 4));
+  REQUIRE(MCP_OK == mcpLoadTxBuffer(&ins, MCP_LOADTXBUFFER_TXB0D0, raw));
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 0, &frame, NULL));
+  REQUIRE(MCP_OK == mcpBitModify(&ins, 0x2C, 0x01, 0x00));
+  REQUIRE(MCP_OK == mcpRTS(&ins, MCP_RTSCMD_BUFFER0));
+  REQUIRE(MCP_OK == mcpReadStatus(&ins));
+  REQUIRE(MCP_OK == mcpRxStatus(&ins));
+  REQUIRE(CountSelect == 0);
+  REQUIRE(CountTransaction == 10);
+
+  // полнодуплексный transfer требует нескольких вызовов и не используется
+  ins.transfer     = countTransfer;
+  CountTransaction = 0;
+  REQUIRE(MCP_OK == mcpReadInto(&ins, 0x0F, raw, 2));
+  REQUIRE(MCP_OK == mcpWrite(&ins, 0x30, raw, 4));
+  REQUIRE(CountTransaction == 2);
+  REQUIRE(CountSelect == 0);
+
+  // без флага CS переключается драйвером
+  ins.flags        = 0;
+  CountTransaction = 0;
+  REQUIRE(MCP_OK == mcpReadInto(&ins, 0x0F, raw, 2));
+  REQUIRE(CountSelect == 2);
+  REQUIRE(CountTransaction == 2);
+}
+
+#ifdef MCP_STATISTICS
+// Счетчик тактов: каждый вызов продвигает время на CycleStep
+static uint32_t Cycles;
+static uint32_t CycleStep;
+
+static uint32_t cycleCounter(void)
+{
+  Cycles += CycleStep;
+  return Cycles;
+}
+
+TEST_CASE("Statistics")
+{
+  MCP_Instance ins = {};
+  MCP_Frame    frame;
+  uint8_t*     data;
+  uint8_t      raw[MCP_BUFFER_SIZE + 8] = {};
+
+  ins.chipSelect   = chipSelect;
+  ins.transaction  = transaction;
+  ins.stats.cycles = cycleCounter;
+  Cycles           = 0;
+  CycleStep        = 100;
+
+  resetState();
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpRead(&ins, 0x0F, &data, 3));
+  REQUIRE(MCP_OK == mcpBitModify(&ins, 0x2C, 0x01, 0x00));
+  REQUIRE(MCP_OK == mcpBitModify(&ins, 0x2C, 0x02, 0x00));
+  REQUIRE(MCP_OK == mcpRTS(&ins, MCP_RTSCMD_BUFFER1));
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_READ].calls == 1);
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_READ].bytes == 5);
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_BITMODIFY].calls == 2);
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_BITMODIFY].bytes == 8);
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_RTS].calls == 1);
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_BITMODIFY].latency[6] == 2);  // 100 тактов
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_OTHER].calls == 0);
+
+  // двухфазное чтение - одна транзакция из двух вызовов
+  const uint8_t std[14] = {0x00, 0x24, 0x60, 0x00, 0x00, 0x03, 0x11, 0x22, 0x33};
+  memcpy(&BufferRx[0], std, sizeof(std));
+  ins.flags = MCP_FLAG_RX_TWOPHASE;
+  REQUIRE(MCP_OK == mcpReceiveFrame(&ins, 0, &frame));
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_READRX].calls == 1);
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_READRX].bytes == 9);
+  ins.flags = 0;
+  memset(&BufferRx[0], 0, sizeof(BufferRx));
+
+  // а если в транзакции ошибка?
+  TransactionError = MCP_ERROR;
+  REQUIRE(MCP_ERROR == mcpLoadTxFrame(&ins, 0, &frame, NULL));
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_LOADTX].calls == 1);
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_LOADTX].errors == 1);
+  TransactionError = MCP_OK;
+
+  // а если данные не помещаются в буфер?
+  REQUIRE(MCP_ERROR_BUFFER == mcpWrite(&ins, 0x00, raw, MCP_BUFFER_SIZE));
+  REQUIRE(ins.stats.bufferErrors == 1);
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_WRITE].calls == 0);
+
+  // векторный транспорт учитывается по сегментам
+  ins.transactionv = vectorTransaction;
+  REQUIRE(MCP_OK == mcpWrite(&ins, 0x00, raw, MCP_BUFFER_SIZE));
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_WRITE].calls == 1);
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_WRITE].bytes == MCP_BUFFER_SIZE + 2);
+  ins.transactionv = NULL;
+
+  // долгие транзакции попадают в последний интервал гистограммы
+  CycleStep = 0x80000000U;
+  REQUIRE(MCP_OK == mcpRxStatus(&ins));
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_RXSTATUS].latency[MCP_STAT_BUCKETS - 1] == 1);
+
+  // без счетчика тактов гистограмма не заполняется
+  mcpStatsReset(&ins);
+  REQUIRE(ins.stats.cycles == cycleCounter);
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_READ].calls == 0);
+  ins.stats.cycles = NULL;
+  REQUIRE(MCP_OK == mcpReadStatus(&ins));
+  REQUIRE(ins.stats.cmd[MCP_COMMAND_READSTATUS].calls == 1);
+  for (uint8_t i = 0; i < MCP_STAT_BUCKETS; i++)
+  {
+    REQUIRE(ins.stats.cmd[MCP_COMMAND_READSTATUS].latency[i] == 0);
+  }
+}
+#endif
+
+// Транспорт для шаблонного драйвера поверх тех же заглушек
+struct TestTransport
+{
+  void    select(bool select) { chipSelect(select); }
+  int32_t transfer(uint8_t* data, uint8_t len) { return transaction(data, len); }
+};
+
+TEST_CASE("Template device")
+{
+  mcp2515::Device<TestTransport> dev;
+  MCP_Instance                   ins = {};
+  uint8_t                        expected[MCP_BUFFER_SIZE];
+  uint8_t                        data[16];
+  uint8_t*                       ptr;
+  uint8_t                        len;
+  MCP_Frame                      frame = {};
+
+  ins.chipSelect  = chipSelect;
+  ins.transaction = transaction;
+
+  for (uint8_t i = 0; i < (uint8_t) sizeof(data); i++)
+    data[i] = (uint8_t) (0x40 + i);
+
+  // шаблонный драйвер формирует те же команды, что и драйвер на C
+  resetState();
+  TransactionError = MCP_OK;
+  REQUIRE(MCP_OK == mcpWrite(&ins, 0x31, data, 6));
+  memcpy(&expected[0], &BufferTx[0], sizeof(expected));
+  resetState();
+  REQUIRE(MCP_OK == dev.write(0x31, data, 6));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+  REQUIRE(0 == memcmp(&BufferTx[0], &expected[0], sizeof(expected)));
+
+  resetState();
+  REQUIRE(MCP_OK == mcpLoadTxBuffer(&ins, MCP_LOADTXBUFFER_TXB1SIDH, data));
+  memcpy(&expected[0], &BufferTx[0], sizeof(expected));
+  resetState();
+  REQUIRE(MCP_OK == dev.loadTxBuffer(MCP_LOADTXBUFFER_TXB1SIDH, data));
+  REQUIRE(0 == memcmp(&BufferTx[0], &expected[0], sizeof(expected)));
+
+  frame.id    = 0x1DA5678;
+  frame.flags = MCP_FRAME_IDE;
+  frame.dlc   = 5;
+  memcpy(&frame.data[0], data, 8);
+  resetState();
+  REQUIRE(MCP_OK == mcpLoadTxFrame(&ins, 1, &frame, NULL));
+  memcpy(&expected[0], &BufferTx[0], sizeof(expected));
+  resetState();
+  REQUIRE(MCP_OK == dev.loadTxFrame(1, frame));
+  REQUIRE(0 == memcmp(&BufferTx[0], &expected[0], sizeof(expected)));
+
+  resetState();
+  REQUIRE(MCP_OK == dev.bitModify(0x2C, 0x03, 0x01));
+  REQUIRE(BufferTx[0] == 0x05);
+  REQUIRE(BufferTx[1] == 0x2C);
+  REQUIRE(BufferTx[2] == 0x03);
+  REQUIRE(BufferTx[3] == 0x01);
+
+  resetState();
+  REQUIRE(MCP_OK == dev.rts(MCP_RTSCMD_BUFFER1));
+  REQUIRE(BufferTx[0] == MCP_RTSCMD_BUFFER1);
+
+  resetState();
+  REQUIRE(MCP_OK == dev.reset());
+  REQUIRE(BufferTx[0] == 0xC0);
+
+  // чтение: принимаемые данные совпадают с драйвером на C
+  const uint8_t image[14] = {0x00, 0x0E, 0xCA, 0x56, 0x78, 0x03, 0x11, 0x22, 0x33};
+  memcpy(&BufferRx[0], image, sizeof(image));
+  resetState();
+  REQUIRE(MCP_OK == dev.read(0x2C, data, 3));
+  REQUIRE(BufferTx[0] == 0x03);
+  REQUIRE(BufferTx[1] == 0x2C);
+  REQUIRE(0 == memcmp(&data[0], &image[2], 3));
+
+  resetState();
+  REQUIRE(MCP_OK == dev.readRxBuffer(MCP_READRXBUFFER_RXB0D0, &ptr, &len));
+  REQUIRE(len == 8);
+  REQUIRE(BufferTx[0] == MCP_READRXBUFFER_RXB0D0);
+  REQUIRE(0 == memcmp(ptr, &image[1], 8));
+
+  MCP_Frame rx = {};
+  resetState();
+  REQUIRE(MCP_OK == dev.receiveFrame(1, rx));
+  REQUIRE(BufferTx[0] == MCP_READRXBUFFER_RXB1SIDH);
+  REQUIRE(rx.id == 0x1DA5678);
+  REQUIRE(rx.flags == MCP_FRAME_IDE);
+  REQUIRE(rx.dlc == 3);
+  REQUIRE(rx.data[2] == 0x33);
+
+  uint8_t status = 0;
+  resetState();
+  REQUIRE(MCP_OK == dev.readStatus(status));
+  REQUIRE(BufferTx[0] == 0xA0);
+  REQUIRE(status == image[1]);
+  resetState();
+  REQUIRE(MCP_OK == dev.rxStatus(status));
+  REQUIRE(BufferTx[0] == 0xB0);
+
+  // проверки аргументов и ошибки транзакции
+  REQUIRE(MCP_ERROR_BUFFER == dev.read(0x00, data, MCP_BUFFER_SIZE - 1));
+  REQUIRE(MCP_ERROR_BUFFER == dev.write(0x00, data, MCP_BUFFER_SIZE - 1));
+  REQUIRE(MCP_ERROR == dev.receiveFrame(2, rx));
+  REQUIRE(MCP_ERROR == dev.loadTxFrame(3, frame));
+  TransactionError = MCP_ERROR;
+  resetState();
+  REQUIRE(MCP_ERROR == dev.bitModify(0x2C, 0x03, 0x01));
+  REQUIRE(SelectState[0] == true);
+  REQUIRE(SelectState[1] == false);
+
+  // а если ошибка при чтении? данные и статус не изменяются
+  memset(&data[0], 0xEE, sizeof(data));
+  status = 0x5A;
+  REQUIRE(MCP_ERROR == dev.read(0x2C, data, 3));
+  REQUIRE(data[0] == 0xEE);
+  REQUIRE(MCP_ERROR == dev.readStatus(status));
+  REQUIRE(MCP_ERROR == dev.rxStatus(status));
+  REQUIRE(status == 0x5A);
+  TransactionError = MCP_OK;
+
+  memset(&BufferRx[0], 0, sizeof(BufferRx));
+}
+
+// Опубликованные значения CNF1..CNF3 для распространенных кварцев (таблица
+// библиотеки MCP_CAN для Arduino, mcp_can_dfs.h). Строки с нулевыми
+// значениями - недостижимые скорости.
+struct BitTimingRow
+{
+  uint32_t osc;
+  uint32_t bitrate;
+  uint8_t  cnf1;
+  uint8_t  cnf2;
+  uint8_t  cnf3;
+};
+
+static const BitTimingRow BitTimingTable[] = {
+  {8000000, 500000, 0x00, 0x90, 0x82},
+  {8000000, 250000, 0x00, 0xB1, 0x85},
+  {8000000, 125000, 0x01, 0xB1, 0x85},
+  {16000000, 1000000, 0x00, 0xD0, 0x82},
+  {16000000, 500000, 0x00, 0xF0, 0x86},
+  {16000000, 250000, 0x41, 0xF1, 0x85},
+  {16000000, 125000, 0x43, 0xF0, 0x86},
+  {20000000, 1000000, 0x00, 0xD9, 0x82},
+  {20000000, 500000, 0x00, 0xFA, 0x87},
+  {20000000, 250000, 0x41, 0xFB, 0x86},
+  {20000000, 125000, 0x03, 0xFA, 0x87},
+  {8000000, 1000000, 0x00, 0x00, 0x00},  // в таблице 4 TQ, меньше допустимых 8
+  {16000000, 33000, 0x00, 0x00, 0x00},
+  {16000000, 0, 0x00, 0x00, 0x00},
+};
+
+// значения вычисляются на этапе компиляции
+static_assert(MCP_BITTIMING_CNF2(MCP_BITTIMING(16000000UL, 500000UL, 875U)) == 0xB5U, "MCP_BITTIMING");
+static_assert(mcp2515::bitTiming(16000000UL, 500000UL, 875U).cnf2 == 0xB5U, "bitTiming");
+static_assert(!mcp2515::bitTiming(8000000UL, 1000000UL, 875U).valid(), "bitTiming");
+static_assert(MCP_BITTIMING(16000000UL, 0UL, 875U) == 0U, "MCP_BITTIMING");
+
+TEST_CASE("Bit timing")
+{
+  for (const BitTimingRow& row : BitTimingTable)
+  {
+    INFO("osc " << row.osc << ", bitrate " << row.bitrate);
+
+    // точка выборки опубликованной настройки
+    const uint32_t brp  = (row.cnf1 & 0x3FU) + 1U;
+    const uint32_t prop = (row.cnf2 & 0x07U) + 1U;
+    const uint32_t ps1  = ((row.cnf2 >> 3) & 0x07U) + 1U;
+    const uint32_t ps2  = (row.cnf3 & 0x07U) + 1U;
+    const uint32_t ntq  = 1U + prop + ps1 + ps2;
+    const uint32_t sp   = (row.cnf2 != 0U) ? (1U + prop + ps1) * 1000U / ntq : 875U;
+
+    const unsigned long      bt     = MCP_BITTIMING(row.osc, row.bitrate, sp);
+    const mcp2515::BitTiming timing = mcp2515::bitTiming(row.osc, row.bitrate, sp);
+    REQUIRE(timing.cnf1 == MCP_BITTIMING_CNF1(bt));
+    REQUIRE(timing.cnf2 == MCP_BITTIMING_CNF2(bt));
+    REQUIRE(timing.cnf3 == MCP_BITTIMING_CNF3(bt));
+    if (row.cnf2 == 0U)
+    {
+      REQUIRE(bt == 0U);
+      REQUIRE_FALSE(timing.valid());
+      continue;
+    }
+
+    // совпадают предделитель, положение точки выборки и длина PS2; SJW, SAM,
+    // SOF и деление сегмента до точки выборки на PropSeg и PS1 выбираются
+    // иначе (SJW = 1, однократная выборка)
+    REQUIRE((timing.cnf1 & 0x3FU) + 1U == brp);
+    REQUIRE((timing.cnf2 & 0x07U) + ((timing.cnf2 >> 3) & 0x07U) + 2U == prop + ps1);
+    REQUIRE((timing.cnf3 & 0x07U) + 1U == ps2);
+    REQUIRE((timing.cnf2 & 0xC0U) == 0x80U);
+    REQUIRE((timing.cnf3 & 0xF8U) == 0x00U);
+  }
 }